@@ -1,30 +1,33 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include "sudoku.h"
 
-void runSA(int **board);
-void runGA(int **board, int **fixed);
-
-// Global variables for board size, subgrid size, and number of hints
+// Global variables for board size, subgrid height, and number of hints
+// (subgrids are sub rows high and size / sub columns wide)
 int size = 9;
 int sub = 3;
 int hints = 30;
+int variant = VARIANT_CLASSIC;  // Extra rules of the game (Variant flags)
 
-// Function to allocate memory for the game board
+// Function to allocate memory for the game board.
+// The row pointers and all rows share one block, so free_board does not depend on the current size.
 int **allocate_board() {
-    int **board = malloc(size * sizeof(int *));  // Allocate memory for rows
+    TRACE_BEGIN(alloc);
+    int **board = malloc(size * sizeof(int *) + size * size * sizeof(int));  // Row pointers followed by the cells
+    int *cells = (int *) (board + size);
+    memset(cells, 0, size * size * sizeof(int));  // Initialize all cells to 0
     for (int i = 0; i < size; i++) {
-        board[i] = calloc(size, sizeof(int));  // Allocate memory for columns and initialize to 0
+        board[i] = cells + i * size;
     }
+    TRACE_END(alloc, "allocate_board");
     return board;
 }
 
 // Function to free the allocated memory for the board
 void free_board(int **board) {
-    for (int i = 0; i < size; i++) {
-        free(board[i]);  // Free each row
-    }
-    free(board);  // Free the board itself
+    free(board);  // Rows live in the same block as the board itself
 }
 
 // Function to display the main menu to the user
@@ -38,28 +41,35 @@ void showMenu() {
     printf("6. Load game\n");
     printf("7. Use Simulated Annealing to solve Sudoku\n");
     printf("8. Use Genetic Algorithm to solve Sudoku\n"); // <== DODANE
-    printf("9. Exit\n");
+    printf("9. Use Min-Conflicts Tabu Search to solve Sudoku\n");
+    printf("10. Race all solvers in parallel (portfolio)\n");
+    printf("11. Exit\n");
     printf("Choose an option: ");
 }
 
+// Function to check if a board size and subgrid height can be played
+int isSupportedSize(int newSize, int newSub) {
+    return newSub >= 2 && newSize % newSub == 0 && newSize / newSub >= newSub && newSize <= MAX_SIZE;
+}
+
 // Function to change the board size based on user input
 void changeBoardSize() {
-    printf("Select board size:\n1. 4x4\n2. 9x9\n3. 16x16\n");
+    // Board size and subgrid height of every option
+    static const int options[][2] = {{4, 2}, {6, 2}, {9, 3}, {12, 3}, {16, 4}, {25, 5}, {36, 6}, {49, 7}};
+    int count = sizeof(options) / sizeof(options[0]);
+
+    printf("Select board size:\n");
+    for (int i = 0; i < count; i++) {
+        int n = options[i][0], h = options[i][1];
+        printf("%d. %dx%d (%dx%d blocks)\n", i + 1, n, n, h, n / h);
+    }
     int s;
     scanf("%d", &s);  // Get the user's choice for board size
 
     // Adjust the global variables based on the user's choice
-    if (s == 1) {
-        size = 4;
-        sub = 2;
-    }
-    else if (s == 2) {
-        size = 9;
-        sub = 3;
-    }
-    else if (s == 3) {
-        size = 16;
-        sub = 4;
+    if (s >= 1 && s <= count) {
+        size = options[s - 1][0];
+        sub = options[s - 1][1];
     }
     else {
         printf("Invalid input\n");  // Handle invalid input
@@ -77,120 +87,254 @@ void showInstructions() {
     printf("\nFill the board so that each number appears only once in each row, column, and block.\n");
     printf("Enter a move as: row column value (e.g., 1 3 5).\n");
     printf("Enter value 0 to remove a number. To quit: -1 -1 -1.\n");
+    printf("Enter -2 -2 0 to undo the last move and -3 -3 0 to redo it.\n");
+    printf("Values above 9 are shown as letters: A = 10, B = 11, and so on.\n");
+    if (variant & VARIANT_DIAGONAL)
+        printf("Variant X: both main diagonals must also hold every number once.\n");
+    if (variant & VARIANT_WINDOKU)
+        printf("Variant windoku: so must the extra windows one cell inside the blocks.\n");
+    if (variant & VARIANT_ANTI_KNIGHT)
+        printf("Variant anti-knight: cells a chess knight's move apart must differ.\n");
 }
 
-// Function to check if a number is present in the given row
-int isInRow(int **board, int row, int num) {
-    for (int col = 0; col < size; col++) {
-        if (board[row][col] == num)
-            return 1;  // Found the number in the row
+// Function to check if placing a number is safe (no conflicts in row, column, or subgrid, nor with the
+// cells the variant rules tie to this one)
+int isSafe(int **board, int row, int col, int num) {
+    const Geometry *g = geometry_current();
+    int cell = row * size + col;
+    for (int k = g->peerStart[cell]; k < g->peerStart[cell + 1]; k++) {
+        int p = g->peers[k];
+        if (board[g->cellRow[p]][g->cellCol[p]] == num)
+            return 0;  // Found the number in the row, column or subgrid
     }
-    return 0;  // Number not found in the row
+    return 1;
 }
 
-// Function to check if a number is present in the given column
-int isInCol(int **board, int col, int num) {
-    for (int row = 0; row < size; row++) {
-        if (board[row][col] == num)
-            return 1;  // Found the number in the column
+// Function to shuffle an array randomly
+void shuffle(int *array, int n) {
+    for (int i = n - 1; i > 0; i--) {
+        int j = rng_next() % (i + 1);
+        int tmp = array[i];
+        array[i] = array[j];
+        array[j] = tmp;
     }
-    return 0;  // Number not found in the column
 }
 
-// Function to check if a number is present in the given subgrid
-int isInBox(int **board, int startRow, int startCol, int num) {
-    for (int i = 0; i < sub; i++) {
-        for (int j = 0; j < sub; j++) {
-            if (board[startRow + i][startCol + j] == num)
-                return 1;  // Found the number in the box
+// Function to fill the empty cells from the given one on using a backtracking algorithm.
+// With progress given, every placement counts as one node and the search stops when the limits say so.
+// Works on the cells of a board row by row and the given geometry only, so it is safe to call from any thread.
+static int backtrack(const Geometry *g, int *cells, int cell, SolveProgress *progress, SolveStatus *status) {
+    while (cell < g->cells && cells[cell] != 0)  // Skip already filled cells
+        cell++;
+    if (cell == g->cells)  // If all cells are filled, return true
+        return 1;
+
+    int numbers[g->size];
+    for (int i = 0; i < g->size; i++) numbers[i] = i + 1;  // Initialize array with numbers 1 to size
+    shuffle(numbers, g->size);  // Shuffle the numbers for randomization
+
+    for (int i = 0; i < g->size; i++) {
+        int num = numbers[i], safe = 1;
+        for (int k = g->peerStart[cell]; k < g->peerStart[cell + 1] && safe; k++)
+            safe = cells[g->peers[k]] != num;  // Check if placing the number is safe
+        if (!safe)
+            continue;
+        if (progress != NULL) {
+            if ((*status = solve_check(progress)) != SOLVE_RUNNING)
+                return 0;  // Deadline, node budget or cancellation
+            progress->iterations++;
         }
+        metrics_add(METRIC_NODES, 1);
+        cells[cell] = num;  // Place the number
+        if (backtrack(g, cells, cell + 1, progress, status))  // Try to fill the rest of the board
+            return 1;
+        cells[cell] = 0;  // Backtrack if not successful
+        metrics_add(METRIC_BACKTRACKS, 1);
+        if (progress != NULL && *status != SOLVE_RUNNING)
+            return 0;
     }
-    return 0;  // Number not found in the box
+    return 0;  // No solution found
 }
 
-// Function to check if placing a number is safe (no conflicts in row, column, or subgrid)
-int isSafe(int **board, int row, int col, int num) {
-    return !isInRow(board, row, num) && !isInCol(board, col, num) && !isInBox(board, row - row % sub, col - col % sub, num);
+// Function to fill the board using a backtracking algorithm
+int fillBoardBacktrack(int **board, int row, int col) {
+    TRACE_BEGIN(fill);
+    PERF_BEGIN(fillPerf);
+    int filled = backtrack(geometry_current(), board[0], row * size + col, NULL, NULL);
+    PERF_END(fillPerf, PERF_FILL, 1);
+    TRACE_END(fill, "fillBoardBacktrack");
+    return filled;
 }
 
-// Function to shuffle an array randomly
-void shuffle(int *array, int n) {
-    for (int i = n - 1; i > 0; i--) {
-        int j = rand() % (i + 1);
-        int tmp = array[i];
-        array[i] = array[j];
-        array[j] = tmp;
+// Function to solve a puzzle with backtracking within the given limits (which may be NULL).
+// The energy of the result is the number of cells left empty.
+SolveResult solveBacktrack(int **board, const SolveLimits *limits) {
+    SolveProgress progress;
+    SolveStatus status = SOLVE_RUNNING;
+    solve_begin(&progress, limits, 0);
+
+    int empty = 0;
+    TRACE_BEGIN(search);
+    PERF_BEGIN(searchPerf);
+    int solved = backtrack(geometry_current(), board[0], 0, &progress, &status);
+    PERF_END(searchPerf, PERF_BACKTRACK, 1);
+    TRACE_END(search, "backtracking search");
+    if (!solved) {
+        for (int i = 0; i < size; i++)
+            for (int j = 0; j < size; j++)
+                if (board[i][j] == 0) empty++;
+        if (empty == 0) empty = 1;  // Full board with conflicting givens
     }
+    return solve_finish(&progress, status, empty);
 }
 
-// Function to fill the board using a backtracking algorithm
-int fillBoardBacktrack(int **board, int row, int col) {
-    if (row == size)  // If all rows are filled, return true
-        return 1;
-    if (col == size)  // Move to the next row
-        return fillBoardBacktrack(board, row + 1, 0);
-    if (board[row][col] != 0)  // Skip already filled cells
-        return fillBoardBacktrack(board, row, col + 1);
+// Function to shuffle the order of rows (or columns) without breaking the blocks:
+// whole bands of bandSize lines are shuffled, then the lines inside every band
+static void shuffleLineOrder(int *order, int bands, int bandSize) {
+    int bandOrder[MAX_SIZE], inner[MAX_SIZE];
+    for (int b = 0; b < bands; b++) bandOrder[b] = b;
+    shuffle(bandOrder, bands);
+
+    for (int b = 0; b < bands; b++) {
+        for (int k = 0; k < bandSize; k++) inner[k] = k;
+        shuffle(inner, bandSize);
+        for (int k = 0; k < bandSize; k++) order[b * bandSize + k] = bandOrder[b] * bandSize + inner[k];
+    }
+}
 
-    int numbers[size];
-    for (int i = 0; i < size; i++) numbers[i] = i + 1;  // Initialize array with numbers 1 to size
-    shuffle(numbers, size);  // Shuffle the numbers for randomization
+// Function to fill the empty cells of a board (row by row, g->cells of them) with a random valid solution.
+// Backtracking from an empty board stalls from 25x25 up, so larger boards start from the
+// shifted base pattern and are randomized with shuffles that keep the board valid.
+// Does not use the global board size, so it is safe to call from any thread.
+void generateCells(const Geometry *g, int *cells) {
+    if (g->size <= 16 || g->variant) {  // The shuffles below only keep rows, columns and blocks valid
+        backtrack(g, cells, 0, NULL, NULL);
+        return;
+    }
 
-    for (int i = 0; i < size; i++) {
-        int num = numbers[i];
-        if (isSafe(board, row, col, num)) {  // Check if placing the number is safe
-            board[row][col] = num;  // Place the number
-            if (fillBoardBacktrack(board, row, col + 1))  // Try to fill the rest of the board
-                return 1;
-            board[row][col] = 0;  // Backtrack if not successful
+    int n = g->size, boxRows = g->boxRows, boxCols = g->boxCols;
+    int digits[MAX_SIZE], rows[MAX_SIZE], cols[MAX_SIZE];
+    for (int i = 0; i < n; i++) digits[i] = i + 1;
+    shuffle(digits, n);
+    shuffleLineOrder(rows, n / boxRows, boxRows);
+    shuffleLineOrder(cols, n / boxCols, boxCols);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int r = rows[i], c = cols[j];
+            cells[i * n + j] = digits[(boxCols * (r % boxRows) + r / boxRows + c) % n];
         }
     }
-    return 0;  // No solution found
 }
 
-// Function to remove K digits from the filled board to create a puzzle
-void removeKDigits(int **board, int k, int **fixed) {
-    int total = size * size;
+// Function to fill an empty board with a random valid solution
+void generateBoard(int **board) {
+    TRACE_BEGIN(generate);
+    if (size <= 16 || variant) {
+        fillBoardBacktrack(board, 0, 0);
+    } else {
+        generateCells(geometry_current(), board[0]);
+    }
+    TRACE_END(generate, "generateBoard");
+}
+
+// Function to remove k digits at random from a filled board of n x n cells, marking the rest as fixed.
+// Does not use the global board size, so it is safe to call from any thread.
+void removeCells(int n, int k, int *cells, int *fixedCells) {
+    int total = n * n;
+    if (k > total) k = total;  // More hints asked for than the board has cells
     int *positions = malloc(total * sizeof(int));  // Create an array of positions
     for (int i = 0; i < total; i++) {
         positions[i] = i;  // Initialize position array with indices
+        fixedCells[i] = 1;  // Mark all cells as fixed initially
     }
 
     shuffle(positions, total);  // Shuffle the positions
 
-    for (int i = 0; i < size; i++)
-        for (int j = 0; j < size; j++)
-            fixed[i][j] = 1;  // Mark all cells as fixed initially
-
     for (int i = 0; i < k; i++) {
         int index = positions[i];  // Get a random position
-        int row = index / size;
-        int col = index % size;
-        board[row][col] = 0;  // Remove the number from the position
-        fixed[row][col] = 0;  // Mark the cell as not fixed
+        cells[index] = 0;  // Remove the number from the position
+        fixedCells[index] = 0;  // Mark the cell as not fixed
     }
 
     free(positions);  // Free the allocated memory for positions
 }
 
-// Function to display the current state of the board
-void displayBoard(int **board) {
-    for (int i = 0; i < size; i++) {
-        if (i % sub == 0 && i != 0) {
-            for (int j = 0; j < size * 2 + sub - 1; j++) printf("-");  // Print row separator
-            printf("\n");
+// Function to remove K digits from the filled board to create a puzzle
+void removeKDigits(int **board, int k, int **fixed) {
+    TRACE_BEGIN(remove);
+    removeCells(size, k, board[0], fixed[0]);
+    TRACE_END(remove, "removeKDigits");
+}
+
+// Function to write a game of any size (parameters, then the cells and fixed flags row by row) to an open file.
+// Does not use the global board size, so it is safe to call from any thread.
+void writeGameCells(FILE *file, int n, int boxRows, int gameHints, const int *cells, const int *fixedCells) {
+    fprintf(file, "%d %d %d\n", n, boxRows, gameHints);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            fprintf(file, "%d ", cells[i * n + j]);
         }
-        for (int j = 0; j < size; j++) {
-            if (j % sub == 0 && j != 0) printf("| ");  // Print column separator
-            if (board[i][j] == 0)
-                printf(". ");  // Empty cells are displayed as dots
-            else
-                printf("%d ", board[i][j]);  // Print filled cells
+        fprintf(file, "\n");
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            fprintf(file, "%d ", fixedCells[i * n + j]);
         }
-        printf("\n");
+        fprintf(file, "\n");
     }
 }
 
+// Function to write a game (parameters, board and fixed cells) to an open file
+void writeGame(FILE *file, int **board, int **fixed) {
+    writeGameCells(file, size, sub, hints, board[0], fixed[0]);  // Boards are contiguous, row by row
+}
+
+// Function to read the next game written by writeGame into newly allocated cell arrays (n * n each).
+// Does not touch the global board size. Returns 0 at the end of the file or if the game is invalid.
+int scanGame(FILE *file, int *n, int *boxRows, int *gameHints, int **cells, int **fixedCells) {
+    if (fscanf(file, "%d %d %d", n, boxRows, gameHints) != 3 || !isSupportedSize(*n, *boxRows))
+        return 0;
+
+    int total = *n * *n;
+    int *newCells = malloc(total * sizeof(int));
+    int *newFixed = malloc(total * sizeof(int));
+    int ok = 1;
+    for (int i = 0; i < total && ok; i++)
+        ok = fscanf(file, "%d", &newCells[i]) == 1 && newCells[i] >= 0 && newCells[i] <= *n;
+    for (int i = 0; i < total && ok; i++)
+        ok = fscanf(file, "%d", &newFixed[i]) == 1;
+
+    if (!ok) {
+        free(newCells);
+        free(newFixed);
+        return 0;
+    }
+    *cells = newCells;
+    *fixedCells = newFixed;
+    return 1;
+}
+
+// Function to read a game written by writeGame from an open file into newly allocated boards.
+// Returns 0 if the file does not hold a valid game; the globals then keep their values.
+int readGame(FILE *file, int ***board, int ***fixed) {
+    int newSize, newSub, newHints, *cells, *fixedCells;
+    if (!scanGame(file, &newSize, &newSub, &newHints, &cells, &fixedCells))
+        return 0;
+
+    size = newSize;
+    sub = newSub;
+    hints = newHints;
+    *board = allocate_board();
+    *fixed = allocate_board();
+    memcpy((*board)[0], cells, size * size * sizeof(int));
+    memcpy((*fixed)[0], fixedCells, size * size * sizeof(int));
+    free(cells);
+    free(fixedCells);
+    return 1;
+}
+
 // Function to save the current game state to a file
 void saveGame(int **board, int **fixed) {
     if (board == NULL || fixed == NULL) {
@@ -204,77 +348,304 @@ void saveGame(int **board, int **fixed) {
         return;
     }
 
-    // Save game parameters and board state to the file
-    fprintf(file, "%d %d %d\n", size, sub, hints);
-    for (int i = 0; i < size; i++) {
-        for (int j = 0; j < size; j++) {
-            fprintf(file, "%d ", board[i][j]);
-        }
-        fprintf(file, "\n");
-    }
-
-    for (int i = 0; i < size; i++) {
-        for (int j = 0; j < size; j++) {
-            fprintf(file, "%d ", fixed[i][j]);
-        }
-        fprintf(file, "\n");
-    }
-
+    writeGame(file, board, fixed);  // Save game parameters and board state to the file
     fclose(file);  // Close the file
     printf("Game saved successfully.\n");
 }
 
-// Function to load a previously saved game state from a file
-void loadGame(int **board, int **fixed) {
+// Function to load a previously saved game state from a file; returns 1 on success
+int loadGame(int ***board, int ***fixed) {
     FILE *file = fopen("sudoku.txt", "r");  // Open file for reading
     if (file == NULL) {
         printf("Error opening file for loading.\n");
-        return;
+        return 0;
     }
 
     // Read the saved game parameters and board state from the file
-    int newSize, newSub, newHints;
-    fscanf(file, "%d %d %d", &newSize, &newSub, &newHints);
+    int **newBoard, **newFixed;
+    int ok = readGame(file, &newBoard, &newFixed);
+    fclose(file);  // Close the file
+    if (!ok) {
+        printf("Invalid save file.\n");
+        return 0;
+    }
+
+    // Free previous memory and keep the loaded board and fixed states
+    if (*board != NULL) free_board(*board);
+    if (*fixed != NULL) free_board(*fixed);
+    *board = newBoard;
+    *fixed = newFixed;
 
-    if (newSize != 4 && newSize != 9 && newSize != 16) {
-        printf("Invalid size in save file.\n");
-        fclose(file);
+    printf("Game loaded successfully.\n");
+    return 1;
+}
+
+// Function to run one solver on a game and report its result; returns the result
+SolveResult solveGame(const char *engine, int **board, int **fixed, const SolveLimits *limits) {
+    SolveResult result;
+    if (strcmp(engine, "sa") == 0) {
+        result = runSA(board, limits);
+        engine = "Simulated Annealing";
+    } else if (strcmp(engine, "ga") == 0) {
+        result = runGA(board, fixed, limits);
+        engine = "Genetic Algorithm";
+    } else if (strcmp(engine, "mc") == 0) {
+        result = runMC(board, limits);
+        engine = "Min-Conflicts Tabu Search";
+    } else if (strcmp(engine, "parallel") == 0) {
+        result = solveParallel(board, searchThreads, limits);
+        engine = "Parallel Backtracking";
+    } else if (strcmp(engine, "sat") == 0) {
+        result = solveSAT(board, limits);
+        engine = "CDCL SAT";
+    } else if (strcmp(engine, "portfolio") == 0) {
+        result = runPortfolio(board, fixed, limits);
+        engine = "Portfolio";
+    } else {
+        result = solveBacktrack(board, limits);
+        engine = "Backtracking";
+    }
+    printSolveResult(engine, result);
+    return result;
+}
+
+// Function to run the solver chosen in the menu (options 7-10) on the current game
+void runSolverChoice(int choice, int **board, int **fixed) {
+    static const char *engines[] = {"sa", "ga", "mc", "portfolio"};
+    if (board == NULL || fixed == NULL) {
+        printf("No game to solve.\n");
         return;
     }
+    solveGame(engines[choice - 7], board, fixed, NULL);
+}
+
+// Function to print command line usage
+void showUsage(const char *program) {
+    printf("Usage:\n");
+    printf("  %s                         start the interactive game\n", program);
+    printf("  %s batch <input> <output> [workers]\n", program);
+    printf("      solve 9x9 puzzles, one 81-character line each, with worker threads pinned to the CPUs\n");
+    printf("  %s verify <input> <output> check the solutions written by batch against the puzzles\n", program);
+    printf("  %s pack <input> <archive>  store 81-character puzzle or solution lines in compact binary records\n", program);
+    printf("  %s unpack <archive> <output> turn an archive back into 81-character lines\n", program);
+    printf("  %s solve <engine> <game> [seconds] [budget]\n", program);
+    printf("      solve a saved game with backtrack, parallel, sat, sa, ga, mc or portfolio, stopping\n");
+    printf("      at the deadline (seconds) or after budget nodes/moves/generations/conflicts (0 = no limit)\n");
+    printf("  %s pipeline <input> <output> [workers]\n", program);
+    printf("      solve a file of saved games with parser, solver and writer threads working in parallel\n");
+    printf("  %s serve <socket> [workers] solve 9x9 puzzles sent over a Unix socket\n", program);
+    printf("  %s count <game> [limit] [threads]\n", program);
+    printf("      count the solutions of a saved game, stopping after limit of them (0 = count all)\n");
+    printf("  %s enumerate <game> <output> [limit] [threads]\n", program);
+    printf("      write the solutions of a saved game to a file, one saved game each\n");
+    printf("Options (any mode):\n");
+    printf("  --metrics-out <file|->       export solver counters to a file or standard output\n");
+    printf("  --metrics-format <prom|json> Prometheus text (default) or JSON\n");
+    printf("  --metrics-interval <seconds> export periodically; SIGUSR1 exports at any time\n");
+    printf("  --ga-local <steps>           min-conflicts moves per GA child (0 = plain GA)\n");
+    printf("  --seed <n>                   seed of the random numbers (default: the clock), to repeat a run\n");
+    printf("  --checkpoint <path>          save SA/GA state to <path>.sa / <path>.ga and resume from it\n");
+    printf("  --checkpoint-interval <seconds> time between two checkpoints of a run (default 30)\n");
+    printf("  --threads <n>                threads of the parallel backtracking solver (default: one per CPU)\n");
+    printf("  --perf <file|->              report hardware counters (cycles, instructions, cache and branch misses)\n");
+    printf("                               of every solver call and their totals (Linux perf_event_open)\n");
+    printf("  --variant <classic|x,windoku,knight> play and solve with extra rules (any combination)\n");
+    printf("  --redraw <full|changed>      redraw the whole board after a move (default) or only the changed cells\n");
+#ifdef SUDOKU_TRACE
+    printf("  --trace <file>               write a Chrome trace of generation and solving phases\n");
+#endif
+}
+
+// Function to solve a saved game from the command line; exits with 0 only if it was solved
+int runSolveCommand(const char *engine, const char *path, double seconds, long long budget) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Error opening %s for reading.\n", path);
+        return 1;
+    }
+    int **board, **fixed;
+    int ok = readGame(file, &board, &fixed);
+    fclose(file);
+    if (!ok) {
+        printf("Invalid game file %s.\n", path);
+        return 1;
+    }
 
-    size = newSize;
-    sub = newSub;
-    hints = newHints;
+    SolveLimits limits = solve_limits(seconds, budget);
+    SolveResult result = solveGame(engine, board, fixed, &limits);
+    displayBoard(board);
 
-    // Free previous memory and allocate new memory for the board and fixed states
-    if (board != NULL) free_board(board);
-    if (fixed != NULL) free_board(fixed);
-    board = allocate_board();
-    fixed = allocate_board();
+    free_board(board);
+    free_board(fixed);
+    return result.status == SOLVE_SOLVED ? 0 : 2;
+}
 
-    // Read the board and fixed states from the file
-    for (int i = 0; i < size; i++) {
-        for (int j = 0; j < size; j++) {
-            fscanf(file, "%d", &board[i][j]);
+// Where the enumerate command writes its solutions
+typedef struct {
+    FILE *file;
+    const int *fixed;  // Fixed cells of the puzzle, row by row
+} SolutionFile;
+
+// Function to write one enumerated solution as a saved game
+static void writeSolution(const int *cells, void *context) {
+    SolutionFile *out = context;
+    writeGameCells(out->file, size, sub, hints, cells, out->fixed);
+}
+
+// Function to count (and with an output path, write) the solutions of a saved game.
+// Exits with 0 once the search finished or reached the limit.
+int runCountCommand(const char *path, const char *outputPath, long long limit, int threads) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Error opening %s for reading.\n", path);
+        return 1;
+    }
+    int **board, **fixed;
+    int ok = readGame(file, &board, &fixed);
+    fclose(file);
+    if (!ok) {
+        printf("Invalid game file %s.\n", path);
+        return 1;
+    }
+
+    CountResult result;
+    if (outputPath != NULL) {
+        SolutionFile out = {fopen(outputPath, "w"), fixed[0]};  // Boards are contiguous, row by row
+        if (out.file == NULL) {
+            printf("Error opening %s for writing.\n", outputPath);
+            free_board(board);
+            free_board(fixed);
+            return 1;
         }
+        result = enumerate_solutions(board, threads, limit, NULL, writeSolution, &out);
+        fclose(out.file);
+    } else {
+        result = count_solutions(board, threads, limit, NULL);
     }
 
-    for (int i = 0; i < size; i++) {
-        for (int j = 0; j < size; j++) {
-            fscanf(file, "%d", &fixed[i][j]);
+    printf("%lld solution%s%s (%d subproblems on %d threads, %lld nodes, %.3f s)\n", result.solutions,
+           result.solutions == 1 ? "" : "s", result.exhaustive ? "" : " or more", result.tasks, result.threads,
+           result.nodes, result.elapsed);
+    if (result.exhaustive)
+        printf("%s\n", result.solutions == 0 ? "The puzzle has no solution." :
+               result.solutions == 1 ? "The solution is unique." : "The solution is not unique.");
+    else if (result.solutions > 1)
+        printf("The solution is not unique.\n");
+
+    free_board(board);
+    free_board(fixed);
+    return result.status == SOLVE_SOLVED || result.status == SOLVE_UNSOLVED ? 0 : 2;
+}
+
+// Function to take the options out of the arguments and apply them (metrics, tracing, solver tuning).
+// Returns 0 if an option is malformed.
+int parseOptions(int *argc, char **argv) {
+    const char *path = NULL;
+    MetricsFormat format = METRICS_PROMETHEUS;
+    double interval = 0;
+    int kept = 1;
+
+    for (int i = 1; i < *argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            argv[kept++] = argv[i];
+            continue;
         }
+        if (i + 1 == *argc)
+            return 0;
+        const char *option = argv[i], *value = argv[++i];
+        if (strcmp(option, "--metrics-out") == 0)
+            path = value;
+        else if (strcmp(option, "--metrics-format") == 0 && strcmp(value, "json") == 0)
+            format = METRICS_JSON;
+        else if (strcmp(option, "--metrics-format") == 0 && strcmp(value, "prom") == 0)
+            format = METRICS_PROMETHEUS;
+        else if (strcmp(option, "--metrics-interval") == 0 && atof(value) > 0)
+            interval = atof(value);
+        else if (strcmp(option, "--seed") == 0)
+            randomSeed = strtoull(value, NULL, 10);
+        else if (strcmp(option, "--checkpoint") == 0)
+            checkpointPath = value;
+        else if (strcmp(option, "--checkpoint-interval") == 0 && atof(value) > 0)
+            checkpointInterval = atof(value);
+        else if (strcmp(option, "--ga-local") == 0 && atoi(value) >= 0)
+            gaLocalSteps = atoi(value);
+        else if (strcmp(option, "--threads") == 0 && atoi(value) > 0)
+            searchThreads = atoi(value);
+        else if (strcmp(option, "--perf") == 0 && perf_start(value))
+            atexit(perf_stop);  // Totals written when the program ends
+        else if (strcmp(option, "--variant") == 0 && variant_parse(value) >= 0)
+            variant = variant_parse(value);
+        else if (strcmp(option, "--redraw") == 0 && strcmp(value, "full") == 0)
+            redrawChanged = 0;
+        else if (strcmp(option, "--redraw") == 0 && strcmp(value, "changed") == 0)
+            redrawChanged = 1;
+#ifdef SUDOKU_TRACE
+        else if (strcmp(option, "--trace") == 0 && trace_start(value))
+            atexit(trace_stop);  // Written when the program ends
+#endif
+        else
+            return 0;
     }
+    *argc = kept;
+    argv[kept] = NULL;
 
-    fclose(file);  // Close the file
-    printf("Game loaded successfully.\n");
+    if (path != NULL) {
+        metrics_start(path, format, interval);
+        atexit(metrics_stop);  // Final export when the program ends
+    }
+    return 1;
+}
+
+// Function to run a non-interactive command given on the command line
+int runCommandLine(int argc, char **argv) {
+    if (strcmp(argv[1], "batch") == 0 && (argc == 4 || argc == 5))
+        return runBatch(argv[2], argv[3], argc == 5 ? atoi(argv[4]) : 0);
+    if (strcmp(argv[1], "verify") == 0 && argc == 4)
+        return runVerify(argv[2], argv[3]);
+    if (strcmp(argv[1], "pack") == 0 && argc == 4)
+        return runPack(argv[2], argv[3]);
+    if (strcmp(argv[1], "unpack") == 0 && argc == 4)
+        return runUnpack(argv[2], argv[3]);
+    if (strcmp(argv[1], "pipeline") == 0 && (argc == 4 || argc == 5))
+        return runPipeline(argv[2], argv[3], argc == 5 ? atoi(argv[4]) : 0);
+    if (strcmp(argv[1], "serve") == 0 && (argc == 3 || argc == 4))
+        return runServer(argv[2], argc == 4 ? atoi(argv[3]) : 0);
+    if (strcmp(argv[1], "count") == 0 && argc >= 3 && argc <= 5)
+        return runCountCommand(argv[2], NULL, argc > 3 ? atoll(argv[3]) : 0, argc > 4 ? atoi(argv[4]) : 0);
+    if (strcmp(argv[1], "enumerate") == 0 && argc >= 4 && argc <= 6)
+        return runCountCommand(argv[2], argv[3], argc > 4 ? atoll(argv[4]) : 0, argc > 5 ? atoi(argv[5]) : 0);
+    if (strcmp(argv[1], "solve") == 0 && argc >= 4 && argc <= 6)
+        return runSolveCommand(argv[2], argv[3], argc > 4 ? atof(argv[4]) : 0, argc > 5 ? atoll(argv[5]) : 0);
+
+    showUsage(argv[0]);
+    return 1;
+}
+
+// Function to start a new puzzle with the current settings: a ready one from the background pool,
+// or one generated on the spot if the pool has none yet
+static void newPuzzle(int **board, int **fixed) {
+    if (pool_take(size, sub, variant, hints, board[0], fixed[0]))
+        return;
+    generateBoard(board);  // Fill the board with a valid Sudoku puzzle
+    removeKDigits(board, size * size - hints, fixed);  // Remove hints to create a puzzle
 }
 
 // Main function to run the game
-int main(void) {
-    srand(time(NULL));
+int main(int argc, char **argv) {
+    randomSeed = time(NULL);
+    if (!parseOptions(&argc, argv)) {
+        showUsage(argv[0]);
+        return 1;
+    }
+    rng_seed(randomSeed);
+    if (argc > 1)
+        return runCommandLine(argc, argv);
+
     int **board = NULL;
     int **fixed = NULL;
     int choice;
+    pool_start();  // Puzzles for New Game are ready before the player asks
+    pool_prefetch(size, sub, variant, hints);
 
     // Main game loop
     while (1) {
@@ -284,25 +655,24 @@ int main(void) {
         if (choice == 1) {
             board = allocate_board();
             fixed = allocate_board();
-
-            fillBoardBacktrack(board, 0, 0);  // Fill the board with a valid Sudoku puzzle
-            removeKDigits(board, size * size - hints, fixed);  // Remove hints to create a puzzle
+            newPuzzle(board, fixed);
             break;
         } else if (choice == 2) {
             changeBoardSize();  // Change the board size
+            pool_prefetch(size, sub, variant, hints);
         } else if (choice == 3) {
             changeDifficulty();  // Change the difficulty level
+            pool_prefetch(size, sub, variant, hints);
         } else if (choice == 4) {
             showInstructions();  // Show instructions
         } else if (choice == 5) {
             saveGame(board, fixed);  // Save the current game
         } else if (choice == 6) {
-            loadGame(board, fixed);  // Load a saved game
-        } else if(choice == 7) {
-        	runSA(board);
-       	} else if (choice == 8) {
-    		runGA(board, fixed);
-		} else if (choice == 9) {
+            if (loadGame(&board, &fixed))  // Load a saved game and continue playing it
+                break;
+        } else if (choice >= 7 && choice <= 10) {
+        	runSolverChoice(choice, board, fixed);
+		} else if (choice == 11) {
     		printf("Exiting...\n");  // Exit
     		exit(0);
 		} else {
@@ -313,12 +683,28 @@ int main(void) {
     // Start the actual game loop where the user plays the game
     int row, col, val;
     time_t start = time(NULL), end;
+    GameState game;
+    game_init(&game, board, fixed);
+    const char *message = NULL;  // Shown below the board, so redrawing the changed cells keeps it visible
 
     while (1) {
         displayBoard(board);  // Display the board
+        if (message != NULL) {
+            printf("%s\n", message);
+            message = NULL;
+        }
         printf("Enter row (1-%d), column (1-%d) and value (0=clear) or -1 -1 0 to show menu: ", size, size);
         scanf("%d %d %d", &row, &col, &val);
 
+        if (row == -2 && col == -2 && val == 0) {
+            if (!game_undo(&game)) message = "Nothing to undo.";
+            continue;
+        }
+        if (row == -3 && col == -3 && val == 0) {
+            if (!game_redo(&game)) message = "Nothing to redo.";
+            continue;
+        }
+
         if (row == -1 && col == -1 && val == 0) {
             printf("Game paused. Choose an option from the menu:\n");
             showMenu();
@@ -331,30 +717,37 @@ int main(void) {
                 }
                 board = allocate_board();
                 fixed = allocate_board();
-
-                fillBoardBacktrack(board, 0, 0);
-                removeKDigits(board, size * size - hints, fixed);
-                break;
+                newPuzzle(board, fixed);
+                game_free(&game);
+                game_init(&game, board, fixed);
+                start = time(NULL);
             } else if (choice == 2) {
                 changeBoardSize();
+                pool_prefetch(size, sub, variant, hints);
             } else if (choice == 3) {
                 changeDifficulty();
+                pool_prefetch(size, sub, variant, hints);
             } else if (choice == 4) {
                 showInstructions();
             } else if (choice == 5) {
                 saveGame(board, fixed);
             } else if (choice == 6) {
-                loadGame(board, fixed);
-            } else if(choice == 7) {
-          		runSA(board);
-            } else if (choice == 8) {
-    		runGA(board, fixed);
-			} else if (choice == 9) {
+                if (loadGame(&board, &fixed)) {
+                    game_free(&game);
+                    game_init(&game, board, fixed);
+                    start = time(NULL);
+                }
+            } else if (choice >= 7 && choice <= 10) {
+          		runSolverChoice(choice, board, fixed);
+                game_free(&game);
+                game_init(&game, board, fixed);
+			} else if (choice == 11) {
     			printf("Exiting...\n");
     			exit(0);
 			} else {
             	printf("Invalid choice.\n");
         	}
+            displayReset();  // The menu scrolled the board away
             continue;
         }
 
@@ -362,41 +755,31 @@ int main(void) {
         col--;  // Adjust for 0-based index
 
         if (row < 0 || row >= size || col < 0 || col >= size) {
-            printf("Invalid coordinates. Try again.\n");
+            message = "Invalid coordinates. Try again.";
             continue;
         }
 
         if (val < 0 || val > size) {
-            printf("Invalid value. Try again.\n");
+            message = "Invalid value. Try again.";
             continue;
         }
 
         if (fixed[row][col]) {
-            printf("Cannot change a fixed cell. Try a different cell.\n");
+            message = "Cannot change a fixed cell. Try a different cell.";
             continue;
         }
 
         if (val == 0) {
-            board[row][col] = 0;  // Clear the cell
-        } else if (isSafe(board, row, col, val)) {
-            board[row][col] = val;  // Place the value in the cell if it's safe
+            game_set(&game, row, col, 0);  // Clear the cell
+        } else if (game_can_place(&game, row, col, val)) {
+            game_set(&game, row, col, val);  // Place the value in the cell if it's safe
         } else {
-            printf("Invalid move. Try again.\n");
+            message = "Invalid move. Try again.";
             continue;
         }
 
         // Check if the game is finished
-        int finished = 1;
-        for (int i = 0; i < size && finished; i++) {
-            for (int j = 0; j < size; j++) {
-                if (board[i][j] == 0) {  // If any cell is still empty
-                    finished = 0;
-                    break;
-                }
-            }
-        }
-
-        if (finished) {  // If the board is full, end the game
+        if (game_finished(&game)) {  // If the board is full, end the game
             end = time(NULL);
             int totalTime = end - start;
             printf("Game time: %d minutes %d seconds\n", totalTime / 60, totalTime % 60);
@@ -404,6 +787,7 @@ int main(void) {
         }
     }
 
+    game_free(&game);
     free_board(board);  // Free the memory for the board
     free_board(fixed);  // Free the memory for the fixed cells
 
@@ -0,0 +1,465 @@
+#define _POSIX_C_SOURCE 200809L  // off_t, pread, open_memstream
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "sudoku.h"
+
+#define BATCH_UNITS (3 * BATCH_SIZE)           // 9 rows, 9 columns and 9 boxes
+#define ALL_DIGITS 0x1FF                       // Candidate bits for digits 1..9
+#define BATCH_CHUNK (1 << 20)                  // Bytes of input read at a time; a worker solves one piece of this size
+
+// Candidate bitmask of one cell for every puzzle in the batch (one puzzle per lane).
+// 16 lanes x 16 bits fill one 256-bit register: GCC emits AVX2 with -mavx2 and SSE2 pairs otherwise.
+typedef unsigned short LaneMask __attribute__((vector_size(BATCH_LANES * sizeof(unsigned short))));
+
+// Cell indices of every row, column and box of a 9x9 board (unitCells of its geometry)
+static const int (*units)[BATCH_SIZE];
+// Row, column and box unit of every cell (cellUnits of the same geometry)
+static const int *cellUnits;
+
+// Function to check if any lane of the mask is non-zero
+static int anyLane(const LaneMask *m) {
+    unsigned short acc = 0;
+    for (int l = 0; l < BATCH_LANES; l++) acc |= (*m)[l];
+    return acc != 0;
+}
+
+// Function to apply naked and hidden singles to all lanes until nothing changes
+static void propagateLanes(LaneMask cand[BATCH_CELLS]) {
+    const LaneMask zero = {0};
+    LaneMask changed;
+
+    do {
+        metrics_add(METRIC_PROPAGATIONS, 1);
+        changed = zero;
+        for (int u = 0; u < BATCH_UNITS; u++) {
+            const int *cells = units[u];
+            LaneMask single[BATCH_SIZE];
+            LaneMask solved = zero, once = zero, twice = zero;
+
+            // Collect digits already fixed in the unit and digits seen once / more than once
+            for (int k = 0; k < BATCH_SIZE; k++) {
+                LaneMask m = cand[cells[k]];
+                single[k] = (LaneMask) ((m & (m - 1)) == 0);  // All ones where the cell has one candidate
+                solved |= m & single[k];
+                twice |= once & m;
+                once |= m;
+            }
+            LaneMask hidden = once & ~twice;  // Digits with exactly one possible place in the unit
+
+            for (int k = 0; k < BATCH_SIZE; k++) {
+                LaneMask m = cand[cells[k]];
+                LaneMask nm = m & ~(solved & ~single[k]);  // Naked singles: remove digits fixed elsewhere
+                LaneMask hit = nm & hidden;                // Hidden singles: keep only the unique digit
+                LaneMask useHit = (LaneMask) (hit != 0);
+                nm = (hit & useHit) | (nm & ~useHit);
+                changed |= nm ^ m;
+                cand[cells[k]] = nm;
+            }
+        }
+    } while (anyLane(&changed));
+}
+
+// Function to convert a candidate mask with one bit set to its digit
+static int maskToDigit(unsigned short m) {
+    return __builtin_ctz(m) + 1;
+}
+
+// Function to parse one puzzle line (81 characters, '0' or '.' for empty cells)
+int batch_parse(const char *line, int cells[BATCH_CELLS]) {
+    int n = 0;
+    for (const char *p = line; *p && *p != '\n' && *p != '\r'; p++) {
+        if (n == BATCH_CELLS) return 0;  // Line too long
+        if (*p == '.' || *p == '0')
+            cells[n++] = 0;
+        else if (*p >= '1' && *p <= '9')
+            cells[n++] = *p - '0';
+        else
+            return 0;  // Unexpected character
+    }
+    return n == BATCH_CELLS;
+}
+
+// Function to check that the digits in a lane do not repeat in any unit and no cell is empty of candidates
+static int laneConsistent(const LaneMask cand[BATCH_CELLS], int lane) {
+    for (int u = 0; u < BATCH_UNITS; u++) {
+        unsigned short seen = 0;
+        for (int k = 0; k < BATCH_SIZE; k++) {
+            unsigned short m = cand[units[u][k]][lane];
+            if (m == 0) return 0;
+            if ((m & (m - 1)) == 0) {
+                if (seen & m) return 0;
+                seen |= m;
+            }
+        }
+    }
+    return 1;
+}
+
+// Function to fill the empty cells of one puzzle by depth-first search, branching on the empty
+// cell with the fewest candidates; used[u] holds the digits placed in unit u.
+// Unlike fillBoardBacktrack it leaves the global board size alone, so server workers can run it in parallel.
+static int searchLane(int cells[BATCH_CELLS], unsigned short used[BATCH_UNITS]) {
+    int best = -1, bestCount = BATCH_SIZE + 1;
+    unsigned short bestFree = 0;
+    for (int i = 0; i < BATCH_CELLS && bestCount > 1; i++) {
+        if (cells[i]) continue;
+        const int *u = &cellUnits[i * UNITS_PER_CELL];
+        unsigned short free = ALL_DIGITS & ~(used[u[0]] | used[u[1]] | used[u[2]]);
+        int count = __builtin_popcount(free);
+        if (count < bestCount) {
+            best = i;
+            bestCount = count;
+            bestFree = free;
+        }
+    }
+    if (best < 0)
+        return 1;  // No empty cell left
+
+    const int *u = &cellUnits[best * UNITS_PER_CELL];
+    while (bestFree) {
+        unsigned short bit = bestFree & -bestFree;
+        bestFree ^= bit;
+        metrics_add(METRIC_NODES, 1);
+        cells[best] = maskToDigit(bit);
+        used[u[0]] |= bit;
+        used[u[1]] |= bit;
+        used[u[2]] |= bit;
+        if (searchLane(cells, used))
+            return 1;
+        used[u[0]] &= ~bit;
+        used[u[1]] &= ~bit;
+        used[u[2]] &= ~bit;
+        metrics_add(METRIC_BACKTRACKS, 1);
+    }
+    cells[best] = 0;
+    return 0;
+}
+
+// Function to finish one lane: read the solution or fall back to scalar backtracking.
+// Returns 1 if solved by propagation, 2 if solved by backtracking and 0 if unsolvable.
+static int finishLane(const LaneMask cand[BATCH_CELLS], int lane, int solution[BATCH_CELLS]) {
+    if (!laneConsistent(cand, lane))
+        return 0;
+
+    int complete = 1;
+    for (int i = 0; i < BATCH_CELLS; i++) {
+        unsigned short m = cand[i][lane];
+        if ((m & (m - 1)) == 0) {
+            solution[i] = maskToDigit(m);
+        } else {
+            solution[i] = 0;
+            complete = 0;
+        }
+    }
+    if (complete)
+        return 1;
+
+    // Puzzle needs branching: search on the propagated board
+    double start = solver_clock();
+    unsigned short used[BATCH_UNITS] = {0};
+    for (int i = 0; i < BATCH_CELLS; i++)
+        for (int t = 0; t < UNITS_PER_CELL && solution[i]; t++)
+            used[cellUnits[i * UNITS_PER_CELL + t]] |= (unsigned short) (1 << (solution[i] - 1));
+    int solved = searchLane(solution, used);
+    metrics_phase(PHASE_FALLBACK, solver_clock() - start);
+
+    return solved ? 2 : 0;
+}
+
+// Function to set up the lookup tables; call it once before solving from several threads
+void batch_prepare() {
+    const Geometry *g = geometry_get(BATCH_SIZE, 3);
+    units = (const int (*)[BATCH_SIZE]) g->unitCells;
+    cellUnits = g->cellUnits;
+}
+
+// Function to solve up to BATCH_LANES puzzles at once. results[l] is 1 if puzzle l was solved by
+// propagation, 2 if it needed backtracking and 0 if it is unsolvable. Safe to call from several threads.
+void batch_solve(int puzzles[][BATCH_CELLS], int count, int solutions[][BATCH_CELLS], int results[]) {
+    LaneMask cand[BATCH_CELLS];
+
+    // Load every puzzle into its own lane; unused lanes stay fully open
+    for (int i = 0; i < BATCH_CELLS; i++) {
+        for (int l = 0; l < BATCH_LANES; l++) {
+            int v = l < count ? puzzles[l][i] : 0;
+            cand[i][l] = v ? (unsigned short) (1 << (v - 1)) : ALL_DIGITS;
+        }
+    }
+
+    TRACE_BEGIN(solve);
+    double start = solver_clock();
+    propagateLanes(cand);
+    metrics_phase(PHASE_PROPAGATE, solver_clock() - start);
+
+    for (int l = 0; l < count; l++)
+        results[l] = finishLane(cand, l, solutions[l]);
+    TRACE_END(solve, "batch solve");
+}
+
+// Function to solve up to BATCH_LANES puzzles at once and write their results
+static void solveBatch(int puzzles[][BATCH_CELLS], int count, FILE *out, int stats[3]) {
+    int solutions[BATCH_LANES][BATCH_CELLS], results[BATCH_LANES];
+    batch_solve(puzzles, count, solutions, results);
+
+    TRACE_BEGIN(output);
+    for (int l = 0; l < count; l++) {
+        stats[results[l]]++;
+        if (results[l] == 0) {
+            fprintf(out, "unsolvable\n");
+            continue;
+        }
+        char line[BATCH_CELLS + 2];
+        for (int i = 0; i < BATCH_CELLS; i++) line[i] = (char) ('0' + solutions[l][i]);
+        line[BATCH_CELLS] = '\n';
+        line[BATCH_CELLS + 1] = '\0';
+        fputs(line, out);
+    }
+    TRACE_END(output, "batch output");
+}
+
+// Counts of one batch run
+typedef struct {
+    int total, invalid;
+    int stats[3];  // Unsolvable, solved by propagation, solved by backtracking
+} BatchCounts;
+
+// Function to solve the puzzle lines of a text (each ending in '\n' or at the end of the text),
+// grouping them in batches of BATCH_LANES, and write one result line per puzzle
+static void solveLines(const char *text, size_t len, FILE *out, BatchCounts *counts) {
+    int puzzles[BATCH_LANES][BATCH_CELLS];
+    int count = 0;
+    const char *end = text + len;
+    TRACE_BEGIN(parse);  // Parsing the lines of one batch
+    for (const char *line = text; line < end; ) {
+        const char *next = memchr(line, '\n', end - line);
+        next = next != NULL ? next + 1 : end;
+        if (line[0] == '\n' || line[0] == '\r' || line[0] == '#') {  // Skip blank lines and comments
+            line = next;
+            continue;
+        }
+        counts->total++;
+        if (!batch_parse(line, puzzles[count])) {
+            // Flush pending puzzles first so the output keeps the input order
+            TRACE_END(parse, "batch parse");
+            solveBatch(puzzles, count, out, counts->stats);
+            TRACE_RESTART(parse);
+            count = 0;
+            fprintf(out, "invalid\n");
+            counts->invalid++;
+        } else if (++count == BATCH_LANES) {
+            TRACE_END(parse, "batch parse");
+            solveBatch(puzzles, count, out, counts->stats);
+            TRACE_RESTART(parse);
+            count = 0;
+        }
+        line = next;
+    }
+    TRACE_END(parse, "batch parse");
+    if (count > 0)
+        solveBatch(puzzles, count, out, counts->stats);
+}
+
+// Function to solve a stream of puzzles on the calling thread, reading it in large blocks; a line cut
+// off at the end of a block is kept for the next one
+static void solveStream(FILE *in, FILE *out, BatchCounts *counts) {
+    size_t capacity = BATCH_CHUNK, len = 0;
+    char *text = malloc(capacity + 1);
+    for (;;) {
+        if (len == capacity) {
+            capacity *= 2;
+            text = realloc(text, capacity + 1);
+        }
+        size_t n = fread(text + len, 1, capacity - len, in);
+        len += n;
+        size_t complete = len;
+        while (n > 0 && complete > 0 && text[complete - 1] != '\n') complete--;
+        text[len] = '\0';
+        solveLines(text, complete, out, counts);
+        memmove(text, text + complete, len - complete);
+        len -= complete;
+        if (n == 0)
+            break;
+    }
+    free(text);
+}
+
+// Shared state of a batch run with several workers. The input is cut into BATCH_CHUNK pieces; a puzzle
+// belongs to the piece its line starts in. Workers take pieces in order and write their results in
+// the same order, so the output matches a run on one thread.
+static struct {
+    int fd;
+    off_t size;
+    FILE *out;
+    long chunks;
+    atomic_long nextChunk;   // Next piece to take
+    long written;            // Pieces written so far (guarded by lock)
+    pthread_mutex_t lock;
+    pthread_cond_t turn;     // Signalled after every write
+    const CpuTopology *topology;
+    int workers;
+    BatchCounts counts;
+} batchRun;
+
+typedef struct {
+    int index;
+    BatchCounts counts;
+} BatchWorker;
+
+// Function to read a byte range of the input, going on after short reads; returns the bytes read
+static size_t readRange(char *buffer, off_t offset, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(batchRun.fd, buffer + done, len - done, offset + (off_t) done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+// Worker thread: pin itself to its CPU, then copy each piece of the input into memory it touches first
+// (so it is allocated on the worker's NUMA node, whichever node holds the page cache), solve it into a
+// buffer of its own and wait for its turn to write
+static void *batchWorker(void *arg) {
+    BatchWorker *worker = arg;
+    TRACE_THREAD("batch worker");
+    const CpuTopology *t = batchRun.topology;
+    topology_pin(t->cpu[topology_slot(t, worker->index, batchRun.workers)]);
+
+    size_t capacity = BATCH_CHUNK + 4096;
+    char *text = malloc(capacity + 1);
+    long chunk;
+    while ((chunk = atomic_fetch_add(&batchRun.nextChunk, 1)) < batchRun.chunks) {
+        off_t start = (off_t) chunk * BATCH_CHUNK;
+        off_t end = start + BATCH_CHUNK < batchRun.size ? start + BATCH_CHUNK : batchRun.size;
+
+        // Read from the byte before the piece (to see whether a line starts at its first byte)
+        // to its end, then on until the line that starts last in the piece is complete
+        off_t from = start > 0 ? start - 1 : 0;
+        size_t len = readRange(text, from, end - from);
+        while (len > 0 && text[len - 1] != '\n') {
+            if (len + 4096 > capacity) {
+                capacity *= 2;
+                text = realloc(text, capacity + 1);
+            }
+            size_t more = readRange(text + len, from + (off_t) len, 4096);
+            const char *newline = memchr(text + len, '\n', more);
+            len = newline != NULL ? (size_t) (newline - text) + 1 : len + more;
+            if (more == 0 || newline != NULL)
+                break;
+        }
+        text[len] = '\0';
+
+        // Lines starting in the piece: from the first line start at or after its first byte
+        size_t first = 0;
+        if (start > 0) {
+            const char *newline = memchr(text, '\n', len);
+            first = newline != NULL ? (size_t) (newline - text) + 1 : len;
+        }
+        if (from + (off_t) first >= end)
+            first = len;  // A line from an earlier piece covers this one
+
+        char *results = NULL;
+        size_t resultLen = 0;
+        FILE *out = open_memstream(&results, &resultLen);
+        solveLines(text + first, len - first, out, &worker->counts);
+        fclose(out);
+
+        pthread_mutex_lock(&batchRun.lock);
+        while (batchRun.written != chunk)
+            pthread_cond_wait(&batchRun.turn, &batchRun.lock);
+        fwrite(results, 1, resultLen, batchRun.out);
+        batchRun.written++;
+        pthread_cond_broadcast(&batchRun.turn);
+        pthread_mutex_unlock(&batchRun.lock);
+        free(results);
+    }
+    free(text);
+    return NULL;
+}
+
+// Function to solve a regular file of puzzles with several pinned workers
+static void solveParallelFile(int fd, off_t inputSize, FILE *out, int workers, const CpuTopology *t) {
+    batchRun.fd = fd;
+    batchRun.size = inputSize;
+    batchRun.out = out;
+    batchRun.chunks = (long) ((inputSize + BATCH_CHUNK - 1) / BATCH_CHUNK);
+    atomic_store(&batchRun.nextChunk, 0);
+    batchRun.written = 0;
+    batchRun.topology = t;
+    batchRun.workers = workers;
+    pthread_mutex_init(&batchRun.lock, NULL);
+    pthread_cond_init(&batchRun.turn, NULL);
+
+    pthread_t *threads = malloc(workers * sizeof(pthread_t));
+    BatchWorker *state = calloc(workers, sizeof(BatchWorker));
+    for (int w = 0; w < workers; w++) {
+        state[w].index = w;
+        pthread_create(&threads[w], NULL, batchWorker, &state[w]);
+    }
+    for (int w = 0; w < workers; w++) {
+        pthread_join(threads[w], NULL);
+        batchRun.counts.total += state[w].counts.total;
+        batchRun.counts.invalid += state[w].counts.invalid;
+        for (int k = 0; k < 3; k++) batchRun.counts.stats[k] += state[w].counts.stats[k];
+    }
+    free(threads);
+    free(state);
+    pthread_mutex_destroy(&batchRun.lock);
+    pthread_cond_destroy(&batchRun.turn);
+}
+
+// Function to solve a file of 9x9 puzzles (one per line) and write one solution per line. A regular
+// file is shared out to workers (0 = one per CPU the program may use); pipes and single workers are
+// read in blocks of BATCH_CHUNK bytes and solved on the calling thread.
+int runBatch(const char *inputPath, const char *outputPath, int workers) {
+    FILE *in = fopen(inputPath, "r");
+    if (in == NULL) {
+        printf("Error opening %s for reading.\n", inputPath);
+        return 1;
+    }
+    FILE *out = fopen(outputPath, "w");
+    if (out == NULL) {
+        printf("Error opening %s for writing.\n", outputPath);
+        fclose(in);
+        return 1;
+    }
+
+    batch_prepare();
+    CpuTopology topology;
+    topology_load(&topology);
+    if (workers <= 0)
+        workers = topology.count;
+
+    memset(&batchRun.counts, 0, sizeof(BatchCounts));
+    double start = solver_clock();
+    struct stat st;
+    int parallel = workers > 1 && fstat(fileno(in), &st) == 0 && S_ISREG(st.st_mode);
+    if (parallel)
+        solveParallelFile(fileno(in), st.st_size, out, workers, &topology);
+    else
+        solveStream(in, out, &batchRun.counts);
+    double seconds = solver_clock() - start;
+
+    fclose(in);
+    fclose(out);
+    topology_free(&topology);
+
+    const BatchCounts *c = &batchRun.counts;
+    printf("Batch finished: %d puzzles, %d solved by propagation, %d by backtracking, %d unsolvable, %d invalid",
+           c->total, c->stats[1], c->stats[2], c->stats[0], c->invalid);
+    if (parallel)
+        printf(" (%d workers on %d NUMA node%s, %.3f s)\n", workers, topology.nodes, topology.nodes > 1 ? "s" : "",
+               seconds);
+    else
+        printf(" (%.3f s)\n", seconds);
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sudoku.h"
+
+#define CHECKPOINT_MAGIC "SDKCKPT1"   // First 8 bytes of a checkpoint file
+#define CHECKPOINT_HEADER 40          // Magic, kind, size, block height, variant, payload length, puzzle hash
+#define CHECKPOINT_TRAILER 8          // Checksum of everything before it
+
+const char *checkpointPath = NULL;   // --checkpoint: SA and GA keep their state in this path plus ".sa" or ".ga"
+double checkpointInterval = 30;      // --checkpoint-interval: seconds between two snapshots of a run
+
+static const char *kindSuffix[] = {".sa", ".ga"};
+
+// One snapshot: header, solver state, checksum
+typedef struct {
+    unsigned char *data;
+    size_t len, cap;
+} CheckpointBuffer;
+
+// Checkpointing of one solver run. The solver fills one buffer while the writer thread writes the other,
+// so a snapshot costs the solver a copy of its state and never waits for the disk. A snapshot the
+// writer has not started yet is replaced by a newer one.
+struct Checkpoint {
+    CheckpointKind kind;
+    char *path, *tempPath;
+    unsigned long long puzzle;   // Hash of the puzzle the state belongs to
+    size_t payload;              // Bytes of solver state in every snapshot
+    double nextSave;             // solver_clock() time of the next periodic snapshot
+    CheckpointBuffer buffer[2];
+    int filling;                 // Buffer between checkpoint_begin and checkpoint_commit
+    int pending;                 // Buffer waiting for the writer, -1 if none
+    int writing;                 // Buffer the writer is writing, -1 if none
+    int stop, failed;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;         // New pending snapshot or stop request
+    unsigned char *saved;        // Snapshot found when the run started, consumed by checkpoint_read
+    size_t readPos;
+};
+
+// Function to hash bytes with 64-bit FNV-1a (puzzle identity and snapshot checksum)
+static unsigned long long fnv1a(unsigned long long hash, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+
+static void put(CheckpointBuffer *b, const void *data, size_t len) {
+    if (b->len + len > b->cap) {
+        b->cap = 2 * (b->len + len);
+        b->data = realloc(b->data, b->cap);
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+// Function to write the fixed header of a snapshot; fields are 32 or 64 bits in the byte order of the machine
+static void putHeader(CheckpointBuffer *b, const Checkpoint *cp) {
+    unsigned int fields[8] = {0, 0, cp->kind, size, sub, variant, (unsigned int) cp->payload, 0};
+    memcpy(fields, CHECKPOINT_MAGIC, 8);
+    b->len = 0;
+    put(b, fields, sizeof(fields));
+    put(b, &cp->puzzle, sizeof(cp->puzzle));
+}
+
+// Writer thread: write every pending snapshot to a temporary file, flush it to the disk and rename it
+// over the checkpoint, so a crash at any time leaves the previous snapshot or the new one
+static void *writeSnapshots(void *arg) {
+    Checkpoint *cp = arg;
+    TRACE_THREAD("checkpoint writer");
+    pthread_mutex_lock(&cp->lock);
+    for (;;) {
+        while (cp->pending < 0 && !cp->stop)
+            pthread_cond_wait(&cp->wake, &cp->lock);
+        if (cp->pending < 0)
+            break;  // Stopped with nothing left to write
+        cp->writing = cp->pending;
+        cp->pending = -1;
+        pthread_mutex_unlock(&cp->lock);
+
+        TRACE_BEGIN(write);
+        const CheckpointBuffer *b = &cp->buffer[cp->writing];
+        FILE *file = fopen(cp->tempPath, "wb");
+        int ok = file != NULL && fwrite(b->data, 1, b->len, file) == b->len && fflush(file) == 0 &&
+                 fsync(fileno(file)) == 0;
+        if (file != NULL && fclose(file) != 0)
+            ok = 0;
+        if (ok && rename(cp->tempPath, cp->path) != 0)
+            ok = 0;
+        if (!ok && !cp->failed) {
+            fprintf(stderr, "Cannot write checkpoint %s: %s\n", cp->path, strerror(errno));
+            cp->failed = 1;
+        }
+        TRACE_END(write, "checkpoint write");
+
+        pthread_mutex_lock(&cp->lock);
+        cp->writing = -1;
+    }
+    pthread_mutex_unlock(&cp->lock);
+    return NULL;
+}
+
+// Function to read the checkpoint of a run and check that it is intact and belongs to the same solver,
+// board shape, variant and puzzle; returns the snapshot or NULL
+static unsigned char *loadSnapshot(const Checkpoint *cp) {
+    FILE *file = fopen(cp->path, "rb");
+    if (file == NULL)
+        return NULL;
+    size_t len = CHECKPOINT_HEADER + cp->payload + CHECKPOINT_TRAILER;
+    unsigned char *data = malloc(len + 1);
+    size_t got = fread(data, 1, len + 1, file);  // One byte more to notice a longer file
+    fclose(file);
+
+    CheckpointBuffer expected = {NULL, 0, 0};
+    putHeader(&expected, cp);
+    int ok = got == len && memcmp(data, expected.data, CHECKPOINT_HEADER) == 0;
+    if (ok) {
+        unsigned long long checksum = fnv1a(FNV_OFFSET, data, len - CHECKPOINT_TRAILER);
+        ok = memcmp(data + len - CHECKPOINT_TRAILER, &checksum, CHECKPOINT_TRAILER) == 0;
+    }
+    free(expected.data);
+    if (!ok) {
+        printf("Checkpoint %s does not match this puzzle and solver; starting afresh.\n", cp->path);
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// Function to start checkpointing a run of a solver on a puzzle (its cells and fixed flags, size * size each)
+// whose state takes payload bytes. Returns NULL without --checkpoint. If the checkpoint file holds a
+// state of the same run, *resumed is set and checkpoint_read gives the state back.
+Checkpoint *checkpoint_open(CheckpointKind kind, const cell_t *puzzle, const unsigned char *fixed, size_t payload,
+                            int *resumed) {
+    *resumed = 0;
+    if (checkpointPath == NULL)
+        return NULL;
+    Checkpoint *cp = calloc(1, sizeof(Checkpoint));
+    cp->kind = kind;
+    cp->payload = payload;
+    size_t len = strlen(checkpointPath) + 8;
+    cp->path = malloc(len);
+    cp->tempPath = malloc(len);
+    snprintf(cp->path, len, "%s%s", checkpointPath, kindSuffix[kind]);
+    snprintf(cp->tempPath, len, "%s.tmp", cp->path);
+    cp->puzzle = fnv1a(fnv1a(FNV_OFFSET, puzzle, size * size * sizeof(cell_t)), fixed, size * size);
+    cp->nextSave = solver_clock() + checkpointInterval;
+    cp->pending = cp->writing = -1;
+
+    cp->saved = loadSnapshot(cp);
+    if (cp->saved != NULL) {
+        cp->readPos = CHECKPOINT_HEADER;
+        *resumed = 1;
+        printf("Resuming from checkpoint %s.\n", cp->path);
+    }
+
+    pthread_mutex_init(&cp->lock, NULL);
+    pthread_cond_init(&cp->wake, NULL);
+    pthread_create(&cp->writer, NULL, writeSnapshots, cp);
+    return cp;
+}
+
+// Function to take the next bytes of the state found by checkpoint_open
+void checkpoint_read(Checkpoint *cp, void *data, size_t len) {
+    memcpy(data, cp->saved + cp->readPos, len);
+    cp->readPos += len;
+}
+
+// Function to check whether the next periodic snapshot is due (reads the clock: call it now and then)
+int checkpoint_due(const Checkpoint *cp) {
+    return cp != NULL && solver_clock() >= cp->nextSave;
+}
+
+// Function to start a snapshot in the buffer the writer is not busy with; a snapshot still waiting in
+// it is dropped, as the new one supersedes it
+void checkpoint_begin(Checkpoint *cp) {
+    pthread_mutex_lock(&cp->lock);
+    cp->filling = cp->writing == 0 ? 1 : 0;
+    if (cp->pending == cp->filling)
+        cp->pending = -1;
+    pthread_mutex_unlock(&cp->lock);
+    putHeader(&cp->buffer[cp->filling], cp);
+}
+
+// Function to add part of the solver state to the snapshot being taken
+void checkpoint_put(Checkpoint *cp, const void *data, size_t len) {
+    put(&cp->buffer[cp->filling], data, len);
+}
+
+// Function to finish the snapshot and hand it to the writer thread
+void checkpoint_commit(Checkpoint *cp) {
+    CheckpointBuffer *b = &cp->buffer[cp->filling];
+    unsigned long long checksum = fnv1a(FNV_OFFSET, b->data, b->len);
+    put(b, &checksum, sizeof(checksum));
+    pthread_mutex_lock(&cp->lock);
+    cp->pending = cp->filling;
+    pthread_cond_signal(&cp->wake);
+    pthread_mutex_unlock(&cp->lock);
+    cp->nextSave = solver_clock() + checkpointInterval;
+}
+
+// Function to end checkpointing: wait until the last snapshot is written, or, when the run ended on its
+// own (solved, or its search is over), remove the checkpoint since there is nothing left to resume
+void checkpoint_close(Checkpoint *cp, int finished) {
+    if (cp == NULL)
+        return;
+    pthread_mutex_lock(&cp->lock);
+    if (finished)
+        cp->pending = -1;
+    cp->stop = 1;
+    pthread_cond_signal(&cp->wake);
+    pthread_mutex_unlock(&cp->lock);
+    pthread_join(cp->writer, NULL);
+    if (finished)
+        remove(cp->path);
+
+    pthread_mutex_destroy(&cp->lock);
+    pthread_cond_destroy(&cp->wake);
+    free(cp->buffer[0].data);
+    free(cp->buffer[1].data);
+    free(cp->saved);
+    free(cp->path);
+    free(cp->tempPath);
+    free(cp);
+}
@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sudoku.h"
+
+#define CODEC_ALL_DIGITS 0x1FF
+#define CODEC_BITMAP_BYTES ((BATCH_CELLS + 7) / 8)  // One bit per cell: set for the clues of a puzzle
+#define CODEC_GROUP 20                              // Clue values packed base 9 into one 64-bit word
+
+// Record tags of an archive written by runPack
+enum { RECORD_PUZZLE = 0, RECORD_GRID = 1, RECORD_UNSOLVABLE = 2, RECORD_INVALID = 3 };
+
+// Bits of the rank of each band (three rows) of a grid. Cell by cell, row by row, the digit is stored
+// as its index among the candidates left by the cells before it, so a band's rank is below the product
+// of its candidate counts. The widths cover the largest possible product of every band.
+static const int bandBits[3] = {43, 41, 21};
+
+// Bits of k clue values packed base 9 (the smallest w with 9^k <= 2^w)
+static const int groupBits[CODEC_GROUP + 1] = {
+    0, 4, 7, 10, 13, 16, 20, 23, 26, 29, 32, 35, 39, 42, 45, 48, 51, 54, 58, 61, 64
+};
+
+// ceil(2^64 / r): the quotient of x < 2^60 by r is then (x * reciprocal[r]) >> 64, without a division
+static const unsigned long long reciprocal[BATCH_SIZE + 1] = {
+    0, 0, ~0ULL / 2 + 1, ~0ULL / 3 + 1, ~0ULL / 4 + 1, ~0ULL / 5 + 1,
+    ~0ULL / 6 + 1, ~0ULL / 7 + 1, ~0ULL / 8 + 1, ~0ULL / 9 + 1
+};
+
+// Function to write the low width bits of a value at a bit position (the buffer starts zeroed)
+static void putBits(unsigned char *buf, int pos, unsigned long long value, int width) {
+    for (int done = 0; done < width;) {
+        int shift = (pos + done) & 7, take = 8 - shift;
+        if (take > width - done) take = width - done;
+        buf[(pos + done) >> 3] |= (unsigned char) (((value >> done) & ((1u << take) - 1)) << shift);
+        done += take;
+    }
+}
+
+// Function to read width bits at a bit position
+static unsigned long long getBits(const unsigned char *buf, int pos, int width) {
+    unsigned long long value = 0;
+    for (int done = 0; done < width;) {
+        int shift = (pos + done) & 7, take = 8 - shift;
+        if (take > width - done) take = width - done;
+        value |= (unsigned long long) ((buf[(pos + done) >> 3] >> shift) & ((1u << take) - 1)) << done;
+        done += take;
+    }
+    return value;
+}
+
+// Function to encode a complete 9x9 grid (digits 1..9, row by row) in CODEC_GRID_BYTES bytes.
+// Returns 0 if the grid is not a valid solution.
+int codec_encode_grid(const unsigned char grid[BATCH_CELLS], unsigned char out[CODEC_GRID_BYTES]) {
+    unsigned short used[3 * BATCH_SIZE] = {0};  // Rows, columns and boxes
+    unsigned char rank[BATCH_CELLS], radix[BATCH_CELLS];
+
+    for (int i = 0; i < BATCH_CELLS; i++) {
+        int r = i / BATCH_SIZE, c = i % BATCH_SIZE, b = (r / 3) * 3 + c / 3;
+        if (grid[i] < 1 || grid[i] > BATCH_SIZE)
+            return 0;
+        unsigned short bit = (unsigned short) (1 << (grid[i] - 1));
+        unsigned short free = CODEC_ALL_DIGITS & ~(used[r] | used[BATCH_SIZE + c] | used[2 * BATCH_SIZE + b]);
+        if (!(free & bit))
+            return 0;
+        rank[i] = (unsigned char) __builtin_popcount(free & (bit - 1));
+        radix[i] = (unsigned char) __builtin_popcount(free);
+        used[r] |= bit;
+        used[BATCH_SIZE + c] |= bit;
+        used[2 * BATCH_SIZE + b] |= bit;
+    }
+
+    // The first cell of a band is the lowest mixed radix digit of its rank
+    memset(out, 0, CODEC_GRID_BYTES);
+    int pos = 0;
+    for (int band = 0; band < 3; band++) {
+        unsigned long long value = 0;
+        for (int i = (band + 1) * 3 * BATCH_SIZE - 1; i >= band * 3 * BATCH_SIZE; i--)
+            value = value * radix[i] + rank[i];
+        putBits(out, pos, value, bandBits[band]);
+        pos += bandBits[band];
+    }
+    return 1;
+}
+
+// Function to decode a grid written by codec_encode_grid. Returns 0 if the bytes are not a valid code.
+int codec_decode_grid(const unsigned char in[CODEC_GRID_BYTES], unsigned char grid[BATCH_CELLS]) {
+    unsigned short used[3 * BATCH_SIZE] = {0};
+    int pos = 0;
+
+    for (int band = 0; band < 3; band++) {
+        unsigned long long value = getBits(in, pos, bandBits[band]);
+        pos += bandBits[band];
+        for (int r = 3 * band; r < 3 * band + 3; r++) {
+            for (int c = 0; c < BATCH_SIZE; c++) {
+                unsigned short *box = &used[2 * BATCH_SIZE + band * 3 + c / 3];
+                unsigned short free = CODEC_ALL_DIGITS & ~(used[r] | used[BATCH_SIZE + c] | *box);
+                int radix = __builtin_popcount(free);
+                if (radix == 0)
+                    return 0;
+                if (radix > 1) {  // Drop the candidates below the digit's index
+                    unsigned long long q = (unsigned long long) (((unsigned __int128) value * reciprocal[radix]) >> 64);
+                    for (int k = (int) (value - q * radix); k > 0; k--) free &= free - 1;
+                    value = q;
+                }
+                unsigned short bit = free & -free;
+                grid[r * BATCH_SIZE + c] = (unsigned char) __builtin_ffs(bit);
+                used[r] |= bit;
+                used[BATCH_SIZE + c] |= bit;
+                *box |= bit;
+            }
+        }
+        if (value != 0)
+            return 0;  // Rank beyond the candidates of the band
+    }
+    return 1;
+}
+
+// Function to encode a 9x9 puzzle (0 for empty cells) as a clue bitmap followed by the clue values
+// packed base 9. Returns the number of bytes written (at most CODEC_PUZZLE_MAX_BYTES), 0 for a bad cell.
+int codec_encode_puzzle(const unsigned char cells[BATCH_CELLS], unsigned char *out) {
+    unsigned long long value = 0, scale = 1;
+    int pos = CODEC_BITMAP_BYTES * 8, count = 0;
+    memset(out, 0, CODEC_PUZZLE_MAX_BYTES);
+
+    for (int i = 0; i < BATCH_CELLS; i++) {
+        if (cells[i] > BATCH_SIZE)
+            return 0;
+        if (cells[i] == 0)
+            continue;
+        out[i >> 3] |= (unsigned char) (1 << (i & 7));
+        value += (cells[i] - 1) * scale;
+        scale *= BATCH_SIZE;
+        if (++count == CODEC_GROUP) {
+            putBits(out, pos, value, groupBits[count]);
+            pos += groupBits[count];
+            value = 0;
+            scale = 1;
+            count = 0;
+        }
+    }
+    putBits(out, pos, value, groupBits[count]);
+    pos += groupBits[count];
+    return (pos + 7) / 8;
+}
+
+// Function to decode a puzzle written by codec_encode_puzzle from a buffer of len bytes.
+// Returns the number of bytes read, 0 if the buffer is too short or not a valid code.
+int codec_decode_puzzle(const unsigned char *in, int len, unsigned char cells[BATCH_CELLS]) {
+    if (len < CODEC_BITMAP_BYTES)
+        return 0;
+    if (in[CODEC_BITMAP_BYTES - 1] >> (BATCH_CELLS - 8 * (CODEC_BITMAP_BYTES - 1)) != 0)
+        return 0;  // Bits after the last cell are always clear: the record is damaged
+    int clues = 0;
+    for (int k = 0; k < CODEC_BITMAP_BYTES; k++) clues += __builtin_popcount(in[k]);
+    int bits = CODEC_BITMAP_BYTES * 8 + (clues / CODEC_GROUP) * groupBits[CODEC_GROUP] + groupBits[clues % CODEC_GROUP];
+    int bytes = (bits + 7) / 8;
+    if (clues > BATCH_CELLS || len < bytes)
+        return 0;
+
+    int pos = CODEC_BITMAP_BYTES * 8, left = 0;
+    unsigned long long value = 0;
+    for (int i = 0; i < BATCH_CELLS; i++) {
+        if (!(in[i >> 3] >> (i & 7) & 1)) {
+            cells[i] = 0;
+            continue;
+        }
+        if (left == 0) {  // Next group of clue values
+            left = clues < CODEC_GROUP ? clues : CODEC_GROUP;
+            value = getBits(in, pos, groupBits[left]);
+            pos += groupBits[left];
+            clues -= left;
+        }
+        cells[i] = (unsigned char) (value % BATCH_SIZE + 1);
+        value /= BATCH_SIZE;
+        if (--left == 0 && value != 0)
+            return 0;  // Group value beyond 9^k
+    }
+    return bytes;
+}
+
+// Function to pack a file of 81-character lines (puzzles of the batch command, or its output) into an
+// archive of binary records: a tag byte, then a grid or puzzle code. Lines "unsolvable" and "invalid"
+// are kept as tags.
+int runPack(const char *inputPath, const char *outputPath) {
+    FILE *in = fopen(inputPath, "r");
+    if (in == NULL) {
+        printf("Error opening %s for reading.\n", inputPath);
+        return 1;
+    }
+    FILE *out = fopen(outputPath, "wb");
+    if (out == NULL) {
+        printf("Error opening %s for writing.\n", outputPath);
+        fclose(in);
+        return 1;
+    }
+
+    char line[256];
+    int cells[BATCH_CELLS];
+    unsigned char grid[BATCH_CELLS], record[1 + CODEC_PUZZLE_MAX_BYTES];
+    long lines = 0, grids = 0, puzzles = 0, skipped = 0, inBytes = 0, outBytes = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        inBytes += strlen(line);
+        if (line[0] == '\n' || line[0] == '\r' || line[0] == '#') continue;  // Skip blank lines and comments
+        lines++;
+        int len = 0;
+        if (strncmp(line, "unsolvable", 10) == 0) {
+            record[len++] = RECORD_UNSOLVABLE;
+        } else if (strncmp(line, "invalid", 7) == 0) {
+            record[len++] = RECORD_INVALID;
+        } else if (batch_parse(line, cells)) {
+            for (int i = 0; i < BATCH_CELLS; i++) grid[i] = (unsigned char) cells[i];
+            if (codec_encode_grid(grid, record + 1)) {
+                record[len++] = RECORD_GRID;
+                len += CODEC_GRID_BYTES;
+                grids++;
+            } else {
+                record[len++] = RECORD_PUZZLE;
+                len += codec_encode_puzzle(grid, record + 1);
+                puzzles++;
+            }
+        } else {
+            skipped++;
+            continue;
+        }
+        fwrite(record, 1, len, out);
+        outBytes += len;
+    }
+    fclose(in);
+    fclose(out);
+
+    printf("Pack finished: %ld lines, %ld solved grids, %ld puzzles, %ld unreadable lines skipped, "
+           "%ld bytes -> %ld bytes (%.1fx smaller)\n", lines, grids, puzzles, skipped, inBytes, outBytes,
+           outBytes > 0 ? (double) inBytes / outBytes : 0.0);
+    return 0;
+}
+
+// Function to turn an archive written by runPack back into 81-character lines
+int runUnpack(const char *inputPath, const char *outputPath) {
+    FILE *in = fopen(inputPath, "rb");
+    if (in == NULL) {
+        printf("Error opening %s for reading.\n", inputPath);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    unsigned char *data = malloc(size > 0 ? size : 1);
+    if (fread(data, 1, size, in) != (size_t) size) size = 0;
+    fclose(in);
+    FILE *out = fopen(outputPath, "w");
+    if (out == NULL) {
+        printf("Error opening %s for writing.\n", outputPath);
+        free(data);
+        return 1;
+    }
+
+    unsigned char grid[BATCH_CELLS];
+    char line[BATCH_CELLS + 2];
+    line[BATCH_CELLS] = '\n';
+    line[BATCH_CELLS + 1] = '\0';
+    long records = 0, pos = 0;
+    int ok = 1;
+    double start = solver_clock();
+    while (pos < size && ok) {
+        int tag = data[pos++], used = 0;
+        if (tag == RECORD_GRID && size - pos >= CODEC_GRID_BYTES && codec_decode_grid(data + pos, grid))
+            used = CODEC_GRID_BYTES;
+        else if (tag == RECORD_PUZZLE)
+            used = codec_decode_puzzle(data + pos, (int) (size - pos), grid);
+        else if (tag == RECORD_UNSOLVABLE || tag == RECORD_INVALID) {
+            fputs(tag == RECORD_UNSOLVABLE ? "unsolvable\n" : "invalid\n", out);
+            records++;
+            continue;
+        }
+        if (used == 0) {
+            ok = 0;
+            break;
+        }
+        pos += used;
+        for (int i = 0; i < BATCH_CELLS; i++) line[i] = (char) ('0' + grid[i]);
+        fputs(line, out);
+        records++;
+    }
+    fclose(out);
+    free(data);
+
+    printf("Unpack finished: %ld records (%.3f s)\n", records, solver_clock() - start);
+    if (!ok)
+        printf("Stopped at byte %ld: it is not a valid record.\n", pos - 1);
+    return !ok;
+}
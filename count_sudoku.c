@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sudoku.h"
+
+#define COUNT_TASKS_PER_THREAD 64  // Subproblems per thread: subtrees differ a lot in size, many small ones balance the load
+
+// One search over all solutions, shared by the threads
+typedef struct {
+    const Geometry *geom;
+    cell_t *tasks;              // taskCount subproblems of geom->cells cells each
+    int taskCount;
+    atomic_int nextTask;        // First subproblem nobody has taken yet
+    atomic_llong solutions;     // Solutions reported through the shared counter
+    atomic_int stop;            // Set when the limit is reached or a thread hit the solver limits
+    long long limit;            // Solutions wanted (0 = all)
+    SolutionSink sink;
+    void *context;
+    pthread_mutex_t sinkLock;   // The sink is never called by two threads at once
+    const SolveLimits *limits;
+} Enumeration;
+
+// State of one thread: the subproblem it is working on, with digit masks per unit
+typedef struct {
+    Enumeration *e;
+    cell_t *grid;
+    DigitSet *used;             // used[u] = digits placed in unit u
+    int *empty;                 // Empty cells; the first depth of them are filled by the search
+    int emptyCount;
+    int *solution;              // Solution handed to the sink
+    long long found;            // Solutions counted locally (no sink and no limit)
+    SolveProgress progress;
+    SolveStatus status;         // Why this thread stopped, SOLVE_RUNNING if it ran out of work
+    int cut;                    // Set if the thread left branches unsearched because the search was stopped
+} CountWorker;
+
+// Function to load a board into the digit masks and list its empty cells; returns 0 if two cells that must
+// differ hold the same digit
+int digit_masks_load(const Geometry *g, const cell_t *grid, DigitSet *used, int *empty, int *emptyCount) {
+    memset(used, 0, g->units * sizeof(DigitSet));
+    *emptyCount = 0;
+    for (int cell = 0; cell < g->cells; cell++) {
+        if (grid[cell] == 0) {
+            empty[(*emptyCount)++] = cell;
+            continue;
+        }
+        DigitSet bit = DIGIT_BIT(grid[cell]);
+        if (digit_masks_taken(g, grid, used, cell) & bit)
+            return 0;
+        digit_masks_flip(g, used, cell, bit);
+    }
+    return 1;
+}
+
+// Function to find the empty cell (from position depth of the list on) with the fewest candidates.
+// It is swapped to position depth; returns its candidates (0 if some cell has none).
+DigitSet digit_masks_pick(const Geometry *g, const cell_t *grid, const DigitSet *used, int *empty, int emptyCount, int depth) {
+    DigitSet all = g->size == 64 ? ~0ULL : (1ULL << g->size) - 1;
+    int best = depth, bestCount = g->size + 1;
+    DigitSet bestFree = 0;
+    for (int k = depth; k < emptyCount && bestCount > 1; k++) {
+        DigitSet free = all & ~digit_masks_taken(g, grid, used, empty[k]);
+        int count = DIGIT_COUNT(free);
+        if (count < bestCount) {
+            best = k;
+            bestCount = count;
+            bestFree = free;
+        }
+    }
+    int tmp = empty[depth];
+    empty[depth] = empty[best];
+    empty[best] = tmp;
+    return bestFree;
+}
+
+// Function to report one solution; the search stops once the limit is reached
+static void reportSolution(CountWorker *w) {
+    Enumeration *e = w->e;
+    if (e->sink == NULL && e->limit == 0) {
+        w->found++;  // Plain count: no need to touch the shared counter
+        return;
+    }
+    long long index = atomic_fetch_add(&e->solutions, 1);
+    if (e->limit > 0 && index >= e->limit)
+        return;  // Another thread already reported the last wanted solution
+    if (e->sink != NULL) {
+        for (int cell = 0; cell < e->geom->cells; cell++)
+            w->solution[cell] = w->grid[cell];
+        pthread_mutex_lock(&e->sinkLock);
+        e->sink(w->solution, e->context);
+        pthread_mutex_unlock(&e->sinkLock);
+    }
+    if (e->limit > 0 && index + 1 >= e->limit)
+        atomic_store(&e->stop, 1);
+}
+
+// Function to visit every completion of the worker's board below the given depth
+static void countSubtree(CountWorker *w, int depth) {
+    if (depth == w->emptyCount) {
+        reportSolution(w);
+        return;
+    }
+    const Geometry *g = w->e->geom;
+    DigitSet candidates = digit_masks_pick(g, w->grid, w->used, w->empty, w->emptyCount, depth);
+    if (depth + 1 == w->emptyCount && w->e->sink == NULL && w->e->limit == 0) {
+        w->found += DIGIT_COUNT(candidates);  // Last empty cell of a plain count: every candidate is a solution
+        return;
+    }
+    int cell = w->empty[depth];
+
+    while (candidates) {
+        if (atomic_load_explicit(&w->e->stop, memory_order_relaxed)) {
+            w->cut = 1;
+            break;
+        }
+        SolveStatus status = solve_check(&w->progress);
+        if (status != SOLVE_RUNNING) {
+            w->status = status;
+            atomic_store(&w->e->stop, 1);  // The other threads stop as well: the count is incomplete anyway
+            break;
+        }
+        w->progress.iterations++;
+        metrics_add(METRIC_NODES, 1);
+
+        DigitSet bit = candidates & -candidates;
+        candidates ^= bit;
+        w->grid[cell] = __builtin_ctzll(bit) + 1;
+        digit_masks_flip(g, w->used, cell, bit);
+        countSubtree(w, depth + 1);
+        digit_masks_flip(g, w->used, cell, bit);
+    }
+    w->grid[cell] = 0;
+}
+
+// Thread function: take subproblems until none are left and search each one completely
+static void *countWorker(void *arg) {
+    CountWorker *w = arg;
+    Enumeration *e = w->e;
+    TRACE_THREAD("solution counter");
+    solve_begin(&w->progress, e->limits, 0);
+
+    int task;
+    while (!atomic_load(&e->stop) && (task = atomic_fetch_add(&e->nextTask, 1)) < e->taskCount) {
+        TRACE_BEGIN(subtree);
+        memcpy(w->grid, &e->tasks[(size_t) task * e->geom->cells], e->geom->cells * sizeof(cell_t));
+        digit_masks_load(e->geom, w->grid, w->used, w->empty, &w->emptyCount);  // Subproblems are consistent
+        countSubtree(w, 0);
+        TRACE_END(subtree, "count subtree");
+    }
+    if (atomic_load(&e->nextTask) < e->taskCount)
+        w->cut = 1;  // Stopped before taking every subproblem
+    return NULL;
+}
+
+// Function to split the puzzle into independent subproblems, one level of placements at a time,
+// until there are enough of them for the threads. Subproblems are kept in search order.
+// Returns the number of subproblems (0 if the givens already conflict); *tasks is allocated.
+static int splitSearch(const Geometry *g, const cell_t *puzzle, int target, cell_t **tasks) {
+    size_t cells = g->cells;
+    DigitSet *used = malloc(g->units * sizeof(DigitSet));
+    int *empty = malloc(cells * sizeof(int)), emptyCount;
+    cell_t *level = malloc(cells);
+    int count = 1;
+    memcpy(level, puzzle, cells);
+    if (!digit_masks_load(g, level, used, empty, &emptyCount))
+        count = 0;
+
+    // Forced cells give one child, so a level does not always add subproblems
+    while (count > 0 && count < target) {
+        cell_t *next = NULL;
+        int nextCount = 0, nextCap = 0, grown = 0;
+        for (int t = 0; t < count; t++) {
+            cell_t *grid = &level[t * cells];
+            digit_masks_load(g, grid, used, empty, &emptyCount);
+            DigitSet candidates = emptyCount > 0 ? digit_masks_pick(g, grid, used, empty, emptyCount, 0) : 0;
+            int children = emptyCount > 0 ? DIGIT_COUNT(candidates) : 1;  // A solved subproblem is kept as it is
+            if (nextCount + children > nextCap) {
+                nextCap = 2 * (nextCount + children);
+                next = realloc(next, nextCap * cells);
+            }
+            if (emptyCount == 0)
+                memcpy(&next[nextCount++ * cells], grid, cells);
+            for (; candidates; candidates &= candidates - 1, grown = 1) {
+                cell_t *child = &next[nextCount++ * cells];
+                memcpy(child, grid, cells);
+                child[empty[0]] = __builtin_ctzll(candidates) + 1;
+            }
+        }
+        free(level);
+        level = next;
+        count = nextCount;
+        if (!grown)
+            break;  // Every subproblem is solved
+    }
+    free(empty);
+    free(used);
+    *tasks = level;
+    return count;
+}
+
+// Function to visit all solutions of the current board (global size and block shape) with several threads,
+// handing each one to the sink. The search tree is split at a shallow depth into subproblems that the
+// threads take one by one. Threads <= 0 uses every core. With a limit > 0 the search stops after that
+// many solutions. The sink gets the solved cells row by row; with several threads the order of the
+// solutions is not fixed. The limits apply to every thread; iteration budgets are per thread.
+CountResult enumerate_solutions(int **board, int threads, long long limit, const SolveLimits *limits,
+                                SolutionSink sink, void *context) {
+    double start = solver_clock();
+    if (threads <= 0)
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0)
+        threads = 1;
+
+    Enumeration e;
+    e.geom = geometry_current();
+    e.limit = limit;
+    e.sink = sink;
+    e.context = context;
+    e.limits = limits;
+    atomic_init(&e.nextTask, 0);
+    atomic_init(&e.solutions, 0);
+    atomic_init(&e.stop, 0);
+    pthread_mutex_init(&e.sinkLock, NULL);
+
+    cell_t *puzzle = malloc(e.geom->cells);
+    for (int cell = 0; cell < e.geom->cells; cell++)
+        puzzle[cell] = board[e.geom->cellRow[cell]][e.geom->cellCol[cell]];
+    TRACE_BEGIN(split);
+    e.taskCount = splitSearch(e.geom, puzzle, threads * COUNT_TASKS_PER_THREAD, &e.tasks);
+    TRACE_END(split, "split search tree");
+    free(puzzle);
+
+    CountWorker *workers = malloc(threads * sizeof(CountWorker));
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    for (int t = 0; t < threads; t++) {
+        CountWorker *w = &workers[t];
+        w->e = &e;
+        w->grid = malloc(e.geom->cells);
+        w->used = malloc(e.geom->units * sizeof(DigitSet));
+        w->empty = malloc(e.geom->cells * sizeof(int));
+        w->solution = malloc(e.geom->cells * sizeof(int));
+        w->found = 0;
+        w->status = SOLVE_RUNNING;
+        w->cut = 0;
+        pthread_create(&ids[t], NULL, countWorker, w);
+    }
+
+    CountResult result = {0, 1, SOLVE_RUNNING, 0, e.taskCount, threads, 0};
+    for (int t = 0; t < threads; t++) {
+        CountWorker *w = &workers[t];
+        pthread_join(ids[t], NULL);
+        result.solutions += w->found;
+        result.nodes += w->progress.iterations;
+        if (w->status != SOLVE_RUNNING)
+            result.status = w->status;
+        if (w->status != SOLVE_RUNNING || w->cut)
+            result.exhaustive = 0;
+        free(w->grid);
+        free(w->used);
+        free(w->empty);
+        free(w->solution);
+    }
+    result.solutions += atomic_load(&e.solutions);
+    if (limit > 0 && result.solutions > limit) {
+        result.solutions = limit;  // Threads racing for the last solution counted past it: there are more
+        result.exhaustive = 0;
+    }
+    if (result.status == SOLVE_RUNNING)
+        result.status = result.solutions > 0 ? SOLVE_SOLVED : SOLVE_UNSOLVED;
+    result.elapsed = solver_clock() - start;
+
+    free(workers);
+    free(ids);
+    free(e.tasks);
+    pthread_mutex_destroy(&e.sinkLock);
+    metrics_phase(PHASE_SOLVE, result.elapsed);
+    return result;
+}
+
+// Function to count the solutions of the current board, stopping at the limit (0 = count them all)
+CountResult count_solutions(int **board, int threads, long long limit, const SolveLimits *limits) {
+    return enumerate_solutions(board, threads, limit, limits, NULL, NULL);
+}
@@ -1,170 +1,491 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
-// External global variables
-extern int size, sub;
-extern void displayBoard(int **board);
+#include <math.h>
+#include "sudoku.h"
 
 #define POP_SIZE 100    // Number of individuals in the population
-#define MAX_GEN 1000   // Maximum number of generations
-#define MUT_RATE 0.01   // Mutation probability
+#define MAX_GEN 1000   // Default budget of generations
+#define MUT_RATE 0.01   // Base mutation probability
+#define MAX_MUT_RATE 0.1   // Mutation probability while the population has lost its diversity
+#define TOURNAMENT 3    // Starting tournament size
+#define MIN_TOURNAMENT 2
+#define MAX_TOURNAMENT 6
+#define LOW_DIVERSITY 0.05    // Mean cell entropy below which mutation goes up and selection pressure down
+#define HIGH_DIVERSITY 0.25   // Mean cell entropy above which both go back towards their base values
+#define STALL_GENERATIONS 50  // Generations without a better best before the population starts afresh
+#define GA_LOCAL_STEPS 20   // Default min-conflicts moves per child (memetic step)
+#define GA_LOCAL_TRIES 8    // Random cells looked at to find one in conflict
 
-// Each individual represents one Sudoku board with a fitness score
+int gaLocalSteps = GA_LOCAL_STEPS;
+
+// Each individual represents one Sudoku board with a fitness score.
+// GA boards are always full, so a unit has (size - distinct digits) conflicts. The score is kept
+// per row and per band of sub rows, so a child only rescores the parts crossover and mutation touched.
 typedef struct {
-    int **grid;   // Array of Sudoku board values
+    cell_t *grid;            // Board values, row by row (size * size cells)
+    int *rowConflicts;       // Conflicts of every row
+    int *boxConflicts;       // Conflicts of the boxes of every band
+    DigitSet *bandColumns;   // bandColumns[band * size + c] = digits of column c inside the band
     int fitness;   // Number of conflicts
 } Individual;
 
-// Copy a board
-int **copy_board(int **src) {
-    int **copy = malloc(size * sizeof(int *));
-    for (int i = 0; i < size; i++) {
-        copy[i] = malloc(size * sizeof(int));
-        memcpy(copy[i], src[i], size * sizeof(int));
+// Count total conflicts
+int evaluate(const cell_t *grid) {
+    const Geometry *g = geometry_current();
+    int conflicts = 0;
+
+    // Row, column and box conflicts
+    for (int u = 0; u < g->units; u++) {
+        const int *cells = &g->unitCells[u * size];
+        DigitSet seen = 0;
+        int filled = 0;
+        for (int k = 0; k < size; k++) {
+            int v = grid[cells[k]];
+            if (v) {
+                seen |= DIGIT_BIT(v);
+                filled++;
+            }
+        }
+        conflicts += filled - DIGIT_COUNT(seen);   // Every repetition of a digit is one conflict
     }
-    return copy;
+
+    // Pairs of a variant board (anti-knight) holding the same digit, counted once per pair
+    for (int cell = 0; g->variant && cell < g->cells; cell++)
+        for (int k = g->pairStart[cell]; k < g->pairStart[cell + 1]; k++)
+            if (g->pairs[k] > cell && grid[cell] && grid[g->pairs[k]] == grid[cell]) conflicts++;
+
+    return conflicts;   // Total number of conflicts
 }
 
-// Free memory used by an individual
-void free_individual(Individual ind) {
-    for (int i = 0; i < size; i++)
-        free(ind.grid[i]);
-    free(ind.grid);
+// Count the conflicts of one row
+static int score_row(const cell_t *grid, int r) {
+    DigitSet seen = 0;
+    for (int c = 0; c < size; c++)
+        seen |= DIGIT_BIT(grid[r * size + c]);
+    return size - DIGIT_COUNT(seen);
 }
 
-// Count total conflicts
-int evaluate(int **grid) {
+// Collect the column digits and count the box conflicts of one band of sub rows
+static void score_band(Individual *ind, int band) {
+    int boxCols = size / sub;
+    DigitSet *columns = &ind->bandColumns[band * size];
+    memset(columns, 0, size * sizeof(DigitSet));
     int conflicts = 0;
 
-    // Row and column conflicts
-    for (int i = 0; i < size; i++) {
-        int row_count[100] = {0}, col_count[100] = {0};
-        for (int j = 0; j < size; j++) {
-            row_count[grid[i][j]]++;
-            col_count[grid[j][i]]++;
-        }
-        for (int k = 1; k <= size; k++) {
-            if (row_count[k] > 1) conflicts += row_count[k] - 1;
-            if (col_count[k] > 1) conflicts += col_count[k] - 1;
+    for (int box = 0; box < sub; box++) {   // A band holds sub boxes of boxCols columns
+        DigitSet seen = 0;
+        for (int r = band * sub; r < (band + 1) * sub; r++) {
+            for (int c = box * boxCols; c < (box + 1) * boxCols; c++) {
+                DigitSet bit = DIGIT_BIT(ind->grid[r * size + c]);
+                seen |= bit;
+                columns[c] |= bit;
+            }
         }
+        conflicts += size - DIGIT_COUNT(seen);
     }
+    ind->boxConflicts[band] = conflicts;
+}
 
-    // Box conflicts
-    for (int r = 0; r < size; r += sub) {
-        for (int c = 0; c < size; c += sub) {
-            int box_count[100] = {0};
-            for (int i = 0; i < sub; i++)
-                for (int j = 0; j < sub; j++)
-                    box_count[grid[r+i][c+j]]++;
-            for (int k = 1; k <= size; k++)
-                if (box_count[k] > 1) conflicts += box_count[k] - 1;
-        }
+// Count the conflicts of a variant board outside rows, columns and boxes: repeated digits in the extra
+// units (diagonals, windows) and pairs of cells (anti-knight) holding the same digit. They are few
+// cells, so they are counted afresh for every child.
+static int score_variant(const Geometry *g, const cell_t *grid) {
+    int conflicts = 0;
+    for (int u = 3 * size; u < g->units; u++) {
+        DigitSet seen = 0;
+        for (int k = 0; k < size; k++) seen |= DIGIT_BIT(grid[g->unitCells[u * size + k]]);
+        conflicts += size - DIGIT_COUNT(seen);
     }
+    for (int cell = 0; cell < g->cells; cell++)
+        for (int k = g->pairStart[cell]; k < g->pairStart[cell + 1]; k++)
+            if (g->pairs[k] > cell && grid[g->pairs[k]] == grid[cell]) conflicts++;
+    return conflicts;
+}
 
-    return conflicts;   // Total number of conflicts
+// Add up the cached row and box conflicts, the column conflicts of the band digits and, on variant
+// boards, the conflicts of the extra rules; the same units the local search counts
+static void sum_fitness(Individual *ind) {
+    int bands = size / sub, fitness = 0;
+    for (int r = 0; r < size; r++) fitness += ind->rowConflicts[r];
+    for (int b = 0; b < bands; b++) fitness += ind->boxConflicts[b];
+    for (int c = 0; c < size; c++) {
+        DigitSet seen = 0;
+        for (int b = 0; b < bands; b++) seen |= ind->bandColumns[b * size + c];
+        fitness += size - DIGIT_COUNT(seen);
+    }
+    if (variant)
+        fitness += score_variant(geometry_current(), ind->grid);
+    ind->fitness = fitness;
+    metrics_add(METRIC_GA_EVALUATIONS, 1);
 }
 
-// Mutate non-fixed cells
-void mutate(int **grid, int **fixed) {
-    for (int i = 0; i < size; i++) {
-        for (int j = 0; j < size; j++) {
-            if (!fixed[i][j] && ((double) rand() / RAND_MAX) < MUT_RATE) {
-                grid[i][j] = rand() % size + 1;   // Assign a new random value
-            }
+// Score an individual from scratch
+static void score_full(Individual *ind) {
+    for (int r = 0; r < size; r++) ind->rowConflicts[r] = score_row(ind->grid, r);
+    for (int b = 0; b < size / sub; b++) score_band(ind, b);
+    sum_fitness(ind);
+}
+
+// Copy an individual together with its cached scores
+static void copy_individual(Individual *dst, const Individual *src) {
+    int bands = size / sub;
+    memcpy(dst->grid, src->grid, size * size * sizeof(cell_t));
+    memcpy(dst->rowConflicts, src->rowConflicts, size * sizeof(int));
+    memcpy(dst->boxConflicts, src->boxConflicts, bands * sizeof(int));
+    memcpy(dst->bandColumns, src->bandColumns, bands * size * sizeof(DigitSet));
+    dst->fitness = src->fitness;
+}
+
+// Mutate non-fixed cells with the given probability; rows that changed are marked dirty.
+// Instead of drawing a random number for every cell, jump straight to the next mutated cell:
+// the gap between mutations is geometrically distributed with parameter rate.
+void mutate(cell_t *grid, const unsigned char *fixed, unsigned char *dirtyRows, double rate) {
+    const double logKeep = log(1.0 - rate);
+    for (int i = -1;;) {
+        double u = (rng_next() + 1.0) / (RNG_MAX + 2.0);   // In (0, 1)
+        i += 1 + (int) (log(u) / logKeep);
+        if (i >= size * size)
+            break;
+        if (!fixed[i]) {
+            grid[i] = rng_next() % size + 1;   // Assign a new random value
+            dirtyRows[i / size] = 1;
         }
     }
 }
 
-// Crossover: copy random rows from two parents
-void crossover(int **parent1, int **parent2, int **child) {
-    for (int i = 0; i < size; i++) {
-        int *row_src = rand() % 2 ? parent1[i] : parent2[i];
-        memcpy(child[i], row_src, size * sizeof(int));
+// Crossover: copy random rows from two parents.
+// Row scores come from the parent that gave the row; the scores of a band are copied only
+// when all its rows come from the same parent, otherwise the band is marked dirty.
+void crossover(const Individual *parent1, const Individual *parent2, Individual *child, unsigned char *dirtyBands) {
+    int bands = size / sub;
+    for (int b = 0; b < bands; b++) {
+        const Individual *first = NULL;
+        dirtyBands[b] = 0;
+        for (int i = b * sub; i < (b + 1) * sub; i++) {
+            const Individual *src = rng_next() % 2 ? parent1 : parent2;
+            memcpy(child->grid + i * size, src->grid + i * size, size * sizeof(cell_t));
+            child->rowConflicts[i] = src->rowConflicts[i];
+            if (first == NULL) first = src;
+            else if (src != first) dirtyBands[b] = 1;
+        }
+        if (!dirtyBands[b]) {
+            memcpy(&child->bandColumns[b * size], &first->bandColumns[b * size], size * sizeof(DigitSet));
+            child->boxConflicts[b] = first->boxConflicts[b];
+        }
     }
 }
 
-// Initialize the starting population
-void initialize_population(Individual pop[], int **board, int **fixed) {
-    for (int i = 0; i < POP_SIZE; i++) {
-        pop[i].grid = copy_board(board);
-        for (int r = 0; r < size; r++) {
-            for (int c = 0; c < size; c++) {
-                if (!fixed[r][c])
-                    pop[i].grid[r][c] = rand() % size + 1;
+// Memetic step: improve a child with a few min-conflicts moves before it joins the population.
+// Each move gives a conflicting unfixed cell the value with the fewest conflicts, scored in O(1)
+// with the digit counts shared with the annealer; rows that changed are marked dirty.
+// The counts belong to counted, the grid of the previous child. Only the cells of the rows in which
+// the new child differs are updated, which on a converging population is a small part of the board.
+static void refine_child(Individual *child, UnitCounts *uc, cell_t *counted, const int *movable, int movableCount,
+                         unsigned char *dirtyRows) {
+    for (int r = 0; r < size; r++) {
+        const cell_t *row = child->grid + r * size;
+        if (memcmp(counted + r * size, row, size * sizeof(cell_t)) == 0) continue;
+        for (int c = 0; c < size; c++) unit_counts_set(uc, counted, r * size + c, row[c]);
+    }
+
+    for (int step = 0; step < gaLocalSteps && uc->conflicts > 0; step++) {
+        int cell = -1;
+        for (int t = 0; t < GA_LOCAL_TRIES && cell < 0; t++) {
+            int candidate = movable[rng_next() % movableCount];
+            if (unit_counts_cell_conflicts(uc, counted, candidate) > 0) cell = candidate;
+        }
+        if (cell < 0) continue;
+
+        // Best other value, ties broken at random; sideways moves are allowed to cross plateaus
+        int bestVal = 0, bestDelta = 0, ties = 0;
+        for (int v = 1; v <= size; v++) {
+            if (v == child->grid[cell]) continue;
+            int delta = unit_counts_set_delta(uc, counted, cell, v);
+            if (bestVal == 0 || delta < bestDelta) {
+                bestVal = v;
+                bestDelta = delta;
+                ties = 1;
+            } else if (delta == bestDelta && rng_next() % ++ties == 0) {
+                bestVal = v;
             }
         }
-        pop[i].fitness = evaluate(pop[i].grid);   // Count conflicts
+        if (bestVal != 0 && bestDelta <= 0) {
+            unit_counts_set(uc, counted, cell, bestVal);
+            child->grid[cell] = bestVal;
+            dirtyRows[cell / size] = 1;
+        }
     }
 }
 
-// Tournament selection: pick best of 3 random individuals
-Individual tournament_selection(Individual pop[]) {
-    int best = rand() % POP_SIZE;
-    for (int i = 0; i < 3; i++) {
-        int candidate = rand() % POP_SIZE;
+// Initialize the population with random values in the free cells
+void initialize_population(Individual pop[], const cell_t *board, const unsigned char *fixed) {
+    for (int i = 0; i < POP_SIZE; i++) {
+        memcpy(pop[i].grid, board, size * size * sizeof(cell_t));
+        for (int c = 0; c < size * size; c++) {
+            if (!fixed[c])
+                pop[i].grid[c] = rng_next() % size + 1;
+        }
+        score_full(&pop[i]);   // Count conflicts
+    }
+}
+
+// Tournament selection: pick best of tournament random individuals
+Individual tournament_selection(Individual pop[], int tournament) {
+    int best = rng_next() % POP_SIZE;
+    for (int i = 1; i < tournament; i++) {
+        int candidate = rng_next() % POP_SIZE;
         if (pop[candidate].fitness < pop[best].fitness)
             best = candidate;
     }
     return pop[best];   // Return best candidate (with lowest fitness)
 }
 
+// Measure the diversity of the population over the unfixed cells: returns the mean entropy of the
+// values of a cell (0 = every individual agrees, 1 = all values equally common) and stores the mean
+// share of cells in which an individual differs from the elite of the population
+static double measure_diversity(const Individual pop[], const Individual *elite, const int *movable, int movableCount,
+                                double *hamming) {
+    int freq[MAX_SIZE + 1];
+    double entropy = 0;
+    long differ = 0;
+    for (int k = 0; k < movableCount; k++) {
+        int cell = movable[k];
+        memset(freq, 0, (size + 1) * sizeof(int));
+        for (int i = 0; i < POP_SIZE; i++) {
+            freq[pop[i].grid[cell]]++;
+            if (pop[i].grid[cell] != elite->grid[cell]) differ++;
+        }
+        for (int v = 1; v <= size; v++) {
+            if (freq[v] == 0) continue;
+            double p = (double) freq[v] / POP_SIZE;
+            entropy -= p * log(p);
+        }
+    }
+    if (movableCount == 0) {
+        *hamming = 0;
+        return 0;
+    }
+    *hamming = (double) differ / ((double) POP_SIZE * movableCount);
+    return entropy / (movableCount * log(size));
+}
+
+// Search state of a GA run between two generations, as kept in a checkpoint
+typedef struct {
+    int gen, lastImprovement, tournament;
+    double mutation;
+} GAProgress;
+
+// Bytes of a GA checkpoint: generator state, progress, best grid and the grids of the population
+#define GA_CHECKPOINT_BYTES (8 + sizeof(GAProgress) + (POP_SIZE + 1) * size * size * sizeof(cell_t))
+
+// Function to snapshot a GA run for --checkpoint, to go on with the generator state rng; the scores
+// are recomputed on resume
+static void saveGA(Checkpoint *checkpoint, const GAProgress *state, const Individual pop[], const Individual *best,
+                   unsigned long long rng) {
+    checkpoint_begin(checkpoint);
+    checkpoint_put(checkpoint, &rng, sizeof(rng));
+    checkpoint_put(checkpoint, state, sizeof(GAProgress));
+    checkpoint_put(checkpoint, best->grid, size * size * sizeof(cell_t));
+    for (int i = 0; i < POP_SIZE; i++)
+        checkpoint_put(checkpoint, pop[i].grid, size * size * sizeof(cell_t));
+    checkpoint_commit(checkpoint);
+}
+
+// Function to continue a GA run from its checkpoint
+static void resumeGA(Checkpoint *checkpoint, GAProgress *state, Individual pop[], Individual *best) {
+    unsigned long long rng;
+    checkpoint_read(checkpoint, &rng, sizeof(rng));
+    checkpoint_read(checkpoint, state, sizeof(GAProgress));
+    checkpoint_read(checkpoint, best->grid, size * size * sizeof(cell_t));
+    score_full(best);
+    for (int i = 0; i < POP_SIZE; i++) {
+        checkpoint_read(checkpoint, pop[i].grid, size * size * sizeof(cell_t));
+        score_full(&pop[i]);
+    }
+    rng_restore(rng);
+}
+
 // Main genetic algorithm loop
-void runGA(int **board, int **fixed) {
-    srand(time(NULL));
-    Individual population[POP_SIZE];
-    initialize_population(population, board, fixed);   // Create initial population
+SolveResult runGA(int **board, int **fixed, const SolveLimits *limits) {
+    PERF_BEGIN(runPerf);
+    SolveProgress progress;
+    solve_begin(&progress, limits, MAX_GEN);
+    SolveStatus status = SOLVE_RUNNING;
+    int cells = size * size, bands = size / sub;
+    int individuals = 2 * POP_SIZE + 1;   // Two generations plus the best one
 
-    Individual best = population[0];  // Start with first individual as best
+    // All grids and scores live in a few blocks, one slice per individual
+    cell_t *storage = malloc(individuals * cells * sizeof(cell_t));
+    int *rowStorage = malloc(individuals * size * sizeof(int));
+    int *boxStorage = malloc(individuals * bands * sizeof(int));
+    DigitSet *columnStorage = malloc(individuals * bands * size * sizeof(DigitSet));
+    cell_t *start = malloc(cells * sizeof(cell_t));
+    unsigned char *fixed_cells = malloc(cells);
+    unsigned char *dirtyRows = malloc(size), *dirtyBands = malloc(bands);
+    int *movable = malloc(cells * sizeof(int)), movableCount = 0;
+    Individual population_a[POP_SIZE], population_b[POP_SIZE], best;
+    Individual *population = population_a, *new_population = population_b;
 
-    for (int gen = 0; gen < MAX_GEN; gen++) {
-        Individual new_population[POP_SIZE];
+    for (int i = 0; i < individuals; i++) {
+        Individual *ind = i < POP_SIZE ? &population_a[i] : i < 2 * POP_SIZE ? &population_b[i - POP_SIZE] : &best;
+        ind->grid = storage + i * cells;
+        ind->rowConflicts = rowStorage + i * size;
+        ind->boxConflicts = boxStorage + i * bands;
+        ind->bandColumns = columnStorage + i * bands * size;
+    }
+    for (int r = 0; r < size; r++) {
+        for (int c = 0; c < size; c++) {
+            start[r * size + c] = board[r][c];
+            fixed_cells[r * size + c] = fixed[r][c] != 0 && board[r][c] != 0;  // Empty cells are never fixed
+            if (!fixed_cells[r * size + c]) movable[movableCount++] = r * size + c;
+        }
+    }
+    UnitCounts local;
+    cell_t *counted = malloc(cells * sizeof(cell_t));   // Grid the digit counts of the local search belong to
+    memcpy(counted, start, cells * sizeof(cell_t));
+    unit_counts_init(&local, geometry_current(), counted);
+    int resumed;
+    Checkpoint *checkpoint = checkpoint_open(CHECKPOINT_GA, start, fixed_cells, GA_CHECKPOINT_BYTES, &resumed);
+
+    TRACE_BEGIN(setup);
+    initialize_population(population, start, fixed_cells);   // Create initial population
+    TRACE_END(setup, "GA setup");
+    metrics_phase(PHASE_SETUP, solver_clock() - progress.start);
+
+    copy_individual(&best, &population[0]);  // Start with first individual as best
+    double mutation = MUT_RATE, diversity = 1, hamming = 1;
+    int tournament = TOURNAMENT, lastImprovement = 0, gen = 0;
+    int elite = 0;   // Best individual of the current population (best is the best ever seen)
+    for (int i = 1; i < POP_SIZE; i++)
+        if (population[i].fitness < population[elite].fitness) elite = i;
+    if (resumed) {
+        GAProgress saved;
+        resumeGA(checkpoint, &saved, population, &best);
+        gen = saved.gen;
+        lastImprovement = saved.lastImprovement;
+        tournament = saved.tournament;
+        mutation = saved.mutation;
+        elite = 0;
+        for (int i = 1; i < POP_SIZE; i++)
+            if (population[i].fitness < population[elite].fitness) elite = i;
+    }
 
-        // Elitism: keep best individual unchanged
-        new_population[0].grid = copy_board(best.grid);
-        new_population[0].fitness = best.fitness;
+    unsigned long long generationRng = rng_state();
+    for (; best.fitness > 0; gen++) {
+        generationRng = rng_state();   // A run stopped inside this generation resumes it from here
+        progress.iterations = gen;
+        if ((status = solve_check(&progress)) != SOLVE_RUNNING)
+            break;  // Deadline, generation budget or cancellation
+        TRACE_BEGIN(generation);
+        PERF_BEGIN(generationPerf);
+
+        // Elitism: keep the best individual of the population unchanged
+        copy_individual(&new_population[0], &population[elite]);
+        elite = 0;
 
         // Create the rest of the new population
-        for (int i = 1; i < POP_SIZE; i++) {
-            Individual p1 = tournament_selection(population);
-            Individual p2 = tournament_selection(population);
+        for (int i = 1; i < POP_SIZE && status == SOLVE_RUNNING; i++) {
+            Individual p1 = tournament_selection(population, tournament);
+            Individual p2 = tournament_selection(population, tournament);
+            Individual *child = &new_population[i];
+
+            crossover(&p1, &p2, child, dirtyBands);   // Combine rows
+            memset(dirtyRows, 0, size);
+            mutate(child->grid, fixed_cells, dirtyRows, mutation);   // Mutate the result
+            if (gaLocalSteps > 0 && movableCount > 0)
+                refine_child(child, &local, counted, movable, movableCount, dirtyRows);   // Local search
 
-            new_population[i].grid = copy_board(p1.grid);   // Start with one parent's grid
-            crossover(p1.grid, p2.grid, new_population[i].grid);   // Combine rows
-            mutate(new_population[i].grid, fixed);   // Mutate the result
-            new_population[i].fitness = evaluate(new_population[i].grid);   // Evaluate it
+            // Rescore only the rows and bands that changed
+            for (int r = 0; r < size; r++) {
+                if (!dirtyRows[r]) continue;
+                child->rowConflicts[r] = score_row(child->grid, r);
+                dirtyBands[r / sub] = 1;
+            }
+            for (int b = 0; b < bands; b++)
+                if (dirtyBands[b]) score_band(child, b);
+            sum_fitness(child);
 
             // Update best if found better individual
-            if (new_population[i].fitness < best.fitness) {
-                free_individual(best);
-                best.grid = copy_board(new_population[i].grid);
-                best.fitness = new_population[i].fitness;
+            if (child->fitness < new_population[elite].fitness)
+                elite = i;
+            if (child->fitness < best.fitness) {
+                copy_individual(&best, child);
+                lastImprovement = gen;
             }
-            // Free memory of intermediate individual
-            free_individual(new_population[i]);
-        }
 
-        if (best.fitness == 0) {
-            printf("\nSudoku solved in generation %d\n", gen);
+            status = solve_check(&progress);   // Large boards: stop in the middle of a generation
+        }
+        if (status != SOLVE_RUNNING)
             break;
+
+        // The new generation replaces the old one
+        Individual *tmp = population;
+        population = new_population;
+        new_population = tmp;
+        progress.iterations = gen + 1;
+        metrics_add(METRIC_GA_GENERATIONS, 1);
+
+        // Adapt mutation and selection pressure to the diversity that is left
+        diversity = measure_diversity(population, &population[elite], movable, movableCount, &hamming);
+        if (diversity < LOW_DIVERSITY) {
+            mutation = fmin(mutation * 1.5, MAX_MUT_RATE);
+            if (tournament > MIN_TOURNAMENT) tournament--;
+        } else if (diversity > HIGH_DIVERSITY) {
+            mutation = fmax(mutation / 1.5, MUT_RATE);
+            if (tournament < MAX_TOURNAMENT) tournament++;
         }
-        if (gen == MAX_GEN - 1) {
-            printf("\nMax generations reached without solution.\n");
+
+        // Stuck at the same best fitness: replace the whole population, elite included, with fresh
+        // individuals. Survivors pull the search back into the old basin (on hard 9x9 puzzles keeping
+        // a fifth of the population solved 6 of 10, a full restart all 10).
+        // The best board stays in best and is still returned if nothing better turns up.
+        if (gen - lastImprovement >= STALL_GENERATIONS) {
+            initialize_population(population, start, fixed_cells);
+            elite = 0;
+            for (int i = 1; i < POP_SIZE; i++)
+                if (population[i].fitness < population[elite].fitness) elite = i;
+            mutation = MUT_RATE;
+            tournament = TOURNAMENT;
+            lastImprovement = gen;
+            metrics_add(METRIC_GA_RESTARTS, 1);
         }
+        PERF_END(generationPerf, PERF_GA_GENERATION, 0);
+        TRACE_END(generation, "GA generation");
 
         if (gen % 100 == 0)
-            printf("Generation %d, best fitness: %d\n", gen, best.fitness);
+            printf("Generation %d, best fitness: %d, diversity %.3f (%.0f%% cells differ from elite), mutation %.3f\n",
+                   gen, best.fitness, diversity, 100 * hamming, mutation);
+        if (checkpoint_due(checkpoint)) {
+            GAProgress next = {gen + 1, lastImprovement, tournament, mutation};
+            saveGA(checkpoint, &next, population, &best, rng_state());
+        }
+    }
+    if (checkpoint != NULL && status != SOLVE_RUNNING) {
+        // Stopped by a limit: keep the state at the start of the unfinished generation for a later run,
+        // with the random numbers it started from, so the resumed run makes the same generation
+        GAProgress next = {gen, lastImprovement, tournament, mutation};
+        saveGA(checkpoint, &next, population, &best, generationRng);
     }
+    checkpoint_close(checkpoint, status == SOLVE_RUNNING);
 
     // Copy final best solution to original board
-    for (int i = 0; i < size; i++)
-        memcpy(board[i], best.grid[i], size * sizeof(int));
+    for (int r = 0; r < size; r++)
+        for (int c = 0; c < size; c++)
+            board[r][c] = best.grid[r * size + c];
 
-    printf("\nSolved Sudoku board:\n");
-    //displayBoard(board);
-
-    free_individual(best);
-    for (int i = 0; i < POP_SIZE; i++)
-        if (population[i].grid != best.grid)
-            free_individual(population[i]);
+    free(storage);
+    free(rowStorage);
+    free(boxStorage);
+    free(columnStorage);
+    free(start);
+    free(fixed_cells);
+    free(dirtyRows);
+    free(dirtyBands);
+    free(movable);
+    unit_counts_free(&local);
+    free(counted);
+    SolveResult result = solve_finish(&progress, status, best.fitness);
+    PERF_END(runPerf, PERF_GA, 1);
+    return result;
 }
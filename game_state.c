@@ -0,0 +1,130 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sudoku.h"
+
+// Function to add (delta = 1) or remove (delta = -1) one digit from a unit and keep its conflicts up to date
+static void updateUnit(GameState *game, int unit, int val, int delta) {
+    unsigned char *c = &game->count[unit * (game->geom->size + 1) + val];
+    if (delta > 0) {
+        if (*c > 0) game->conflicts++;  // The digit was already present: one more repetition
+        (*c)++;
+        game->mask[unit] |= DIGIT_BIT(val);
+    } else {
+        (*c)--;
+        if (*c > 0) game->conflicts--;  // One repetition less
+        else game->mask[unit] &= ~DIGIT_BIT(val);
+    }
+}
+
+// Function to add or remove the value of a cell from its row, column and box (and the extra units of a variant)
+static void updateCell(GameState *game, int row, int col, int val, int delta) {
+    if (val == 0) return;  // Empty cells are not counted
+    const Geometry *g = game->geom;
+    int cell = row * g->size + col;
+    const int *units = &g->cellUnits[cell * UNITS_PER_CELL];
+    for (int t = 0; t < UNITS_PER_CELL; t++)
+        updateUnit(game, units[t], val, delta);
+    if (g->variant)
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++)
+            updateUnit(game, g->extraUnits[k], val, delta);
+    game->filled += delta;
+}
+
+// Function to count the pair cells (anti-knight) of a cell that hold a value
+static int pairsWithValue(const GameState *game, int cell, int val) {
+    const Geometry *g = game->geom;
+    int same = 0;
+    for (int k = g->pairStart[cell]; k < g->pairStart[cell + 1]; k++) {
+        int p = g->pairs[k];
+        if (game->board[g->cellRow[p]][g->cellCol[p]] == val) same++;
+    }
+    return same;
+}
+
+// Function to write a value to the board and update all counters
+static void applyValue(GameState *game, int row, int col, int val) {
+    int cell = row * game->geom->size + col, old = game->board[row][col];
+    updateCell(game, row, col, old, -1);
+    if (game->geom->variant && old) game->conflicts -= pairsWithValue(game, cell, old);
+    game->board[row][col] = val;
+    updateCell(game, row, col, val, 1);
+    if (game->geom->variant && val) game->conflicts += pairsWithValue(game, cell, val);
+}
+
+// Function to build the game state from an existing board (the only O(size^2) step)
+void game_init(GameState *game, int **board, int **fixed) {
+    memset(game, 0, sizeof(GameState));
+    game->board = board;
+    game->fixed = fixed;
+    game->geom = geometry_current();
+    game->count = calloc(game->geom->units * (size + 1), sizeof(unsigned char));
+    game->mask = calloc(game->geom->units, sizeof(DigitSet));
+
+    for (int i = 0; i < size; i++)
+        for (int j = 0; j < size; j++)
+            updateCell(game, i, j, board[i][j], 1);
+    if (game->geom->variant) {  // Every pair holding the same digit is one conflict, seen from both of its cells
+        int same = 0;
+        for (int cell = 0; cell < game->geom->cells; cell++)
+            if (board[cell / size][cell % size])
+                same += pairsWithValue(game, cell, board[cell / size][cell % size]);
+        game->conflicts += same / 2;
+    }
+}
+
+// Function to free the memory owned by the game state (the board itself is not freed)
+void game_free(GameState *game) {
+    free(game->count);
+    free(game->mask);
+    free(game->journal);
+    memset(game, 0, sizeof(GameState));
+}
+
+// Function to check in O(1) if a value can be placed (same rule as isSafe)
+int game_can_place(const GameState *game, int row, int col, int val) {
+    const Geometry *g = game->geom;
+    int cell = row * g->size + col;
+    const int *units = &g->cellUnits[cell * UNITS_PER_CELL];
+    DigitSet used = game->mask[units[0]] | game->mask[units[1]] | game->mask[units[2]];
+    if (g->variant) {
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++)
+            used |= game->mask[g->extraUnits[k]];
+        if (pairsWithValue(game, cell, val)) return 0;
+    }
+    return !(used & DIGIT_BIT(val));
+}
+
+// Function to play a move: the cell is updated and the move is recorded in the journal
+void game_set(GameState *game, int row, int col, int val) {
+    if (game->journalPos == game->journalCap) {
+        game->journalCap = game->journalCap ? game->journalCap * 2 : 64;
+        game->journal = realloc(game->journal, game->journalCap * sizeof(Move));
+    }
+
+    Move move = {row, col, game->board[row][col], val};
+    game->journal[game->journalPos++] = move;
+    game->journalLen = game->journalPos;  // A new move discards the moves that could be redone
+
+    applyValue(game, row, col, val);
+}
+
+// Function to undo the last applied move; returns 0 if there is nothing to undo
+int game_undo(GameState *game) {
+    if (game->journalPos == 0) return 0;
+    Move *move = &game->journal[--game->journalPos];
+    applyValue(game, move->row, move->col, move->oldValue);
+    return 1;
+}
+
+// Function to redo the last undone move; returns 0 if there is nothing to redo
+int game_redo(GameState *game) {
+    if (game->journalPos == game->journalLen) return 0;
+    Move *move = &game->journal[game->journalPos++];
+    applyValue(game, move->row, move->col, move->newValue);
+    return 1;
+}
+
+// Function to check in O(1) if the board is full and has no conflicts
+int game_finished(const GameState *game) {
+    return game->filled == game->geom->cells && game->conflicts == 0;
+}
@@ -0,0 +1,183 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sudoku.h"
+
+// Built geometries, indexed by variant, board size and block height; they live until the program exits
+static Geometry *cache[VARIANT_ALL + 1][MAX_SIZE + 1][MAX_SIZE + 1];
+
+// Names of the variant flags for --variant, in bit order
+static const char *variantNames[] = {"x", "windoku", "knight"};
+
+// Function to list the extra units of a variant board: both diagonals, and the windows of block size
+// that sit one line inside the blocks (for 9x9 the four windoku windows). Every extra unit has n cells.
+// Returns the number of units written to unitCells (NULL only counts them).
+static int buildExtraUnits(int n, int boxRows, int boxCols, int flags, int *unitCells) {
+    int count = 0;
+    if (flags & VARIANT_DIAGONAL) {
+        for (int k = 0; k < n; k++) {
+            if (unitCells != NULL) {
+                unitCells[count * n + k] = k * n + k;
+                unitCells[(count + 1) * n + k] = k * n + (n - 1 - k);
+            }
+        }
+        count += 2;
+    }
+    if (flags & VARIANT_WINDOKU) {
+        for (int top = 1; top + boxRows < n; top += boxRows + 1) {
+            for (int left = 1; left + boxCols < n; left += boxCols + 1) {
+                for (int k = 0; unitCells != NULL && k < n; k++)
+                    unitCells[count * n + k] = (top + k / boxCols) * n + left + k % boxCols;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// Function to build the lookup tables of a board with blocks of boxRows x boxCols cells
+static Geometry *buildGeometry(int n, int boxRows, int flags) {
+    Geometry *g = malloc(sizeof(Geometry));
+    g->size = n;
+    g->boxRows = boxRows;
+    g->boxCols = n / boxRows;
+    g->cells = n * n;
+    g->variant = flags;
+    int extra = buildExtraUnits(n, boxRows, g->boxCols, flags, NULL);
+    g->units = 3 * n + extra;
+    g->unitCells = malloc(g->units * n * sizeof(int));
+    g->cellUnits = malloc(g->cells * UNITS_PER_CELL * sizeof(int));
+    g->cellRow = malloc(g->cells * sizeof(int));
+    g->cellCol = malloc(g->cells * sizeof(int));
+
+    // Units: rows 0..n-1, columns n..2n-1, boxes 2n..3n-1 (boxes numbered row by row), then the extra units
+    int boxFill[MAX_SIZE] = {0};
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) {
+            int cell = r * n + c;
+            int box = (r / boxRows) * boxRows + c / g->boxCols;
+            g->unitCells[r * n + c] = cell;
+            g->unitCells[(n + c) * n + r] = cell;
+            g->unitCells[(2 * n + box) * n + boxFill[box]++] = cell;
+
+            g->cellUnits[cell * UNITS_PER_CELL] = r;
+            g->cellUnits[cell * UNITS_PER_CELL + 1] = n + c;
+            g->cellUnits[cell * UNITS_PER_CELL + 2] = 2 * n + box;
+            g->cellRow[cell] = r;
+            g->cellCol[cell] = c;
+        }
+    }
+    buildExtraUnits(n, boxRows, g->boxCols, flags, &g->unitCells[3 * n * n]);
+
+    // Extra units of every cell, grouped by cell
+    g->extraStart = calloc(g->cells + 1, sizeof(int));
+    g->extraUnits = malloc((extra * n + 1) * sizeof(int));
+    for (int u = 3 * n; u < g->units; u++)
+        for (int k = 0; k < n; k++) g->extraStart[g->unitCells[u * n + k] + 1]++;
+    for (int cell = 0; cell < g->cells; cell++) g->extraStart[cell + 1] += g->extraStart[cell];
+    int *fill = malloc(g->cells * sizeof(int));
+    memcpy(fill, g->extraStart, g->cells * sizeof(int));
+    for (int u = 3 * n; u < g->units; u++)
+        for (int k = 0; k < n; k++) g->extraUnits[fill[g->unitCells[u * n + k]]++] = u;
+
+    // Pairs: cells a knight's move apart, which must differ without sharing a unit
+    static const int knightRow[8] = {-2, -2, -1, -1, 1, 1, 2, 2}, knightCol[8] = {-1, 1, -2, 2, -2, 2, -1, 1};
+    g->pairStart = calloc(g->cells + 1, sizeof(int));
+    g->pairs = malloc((flags & VARIANT_ANTI_KNIGHT ? 8 * g->cells : 1) * sizeof(int));
+    for (int cell = 0, count = 0; cell < g->cells; cell++) {
+        for (int m = 0; (flags & VARIANT_ANTI_KNIGHT) && m < 8; m++) {
+            int r = g->cellRow[cell] + knightRow[m], c = g->cellCol[cell] + knightCol[m];
+            if (r >= 0 && r < n && c >= 0 && c < n)
+                g->pairs[count++] = r * n + c;
+        }
+        g->pairStart[cell + 1] = count;
+    }
+
+    // Peers: every other cell sharing a unit, then the pair cells, each listed once
+    g->peerStart = malloc((g->cells + 1) * sizeof(int));
+    g->peers = malloc(g->cells * ((UNITS_PER_CELL + extra) * n + 8) * sizeof(int));  // Trimmed below
+    char *seen = calloc(g->cells, 1);
+    int count = 0;
+    for (int cell = 0; cell < g->cells; cell++) {
+        int first = count;
+        g->peerStart[cell] = count;
+        seen[cell] = 1;
+        for (int t = 0; t < UNITS_PER_CELL + g->extraStart[cell + 1] - g->extraStart[cell]; t++) {
+            int u = t < UNITS_PER_CELL ? g->cellUnits[cell * UNITS_PER_CELL + t]
+                                       : g->extraUnits[g->extraStart[cell] + t - UNITS_PER_CELL];
+            const int *unit = &g->unitCells[u * n];
+            for (int k = 0; k < n; k++) {
+                if (!seen[unit[k]]) {
+                    seen[unit[k]] = 1;
+                    g->peers[count++] = unit[k];
+                }
+            }
+        }
+        for (int k = g->pairStart[cell]; k < g->pairStart[cell + 1]; k++) {
+            if (!seen[g->pairs[k]]) {
+                seen[g->pairs[k]] = 1;
+                g->peers[count++] = g->pairs[k];
+            }
+        }
+        for (int k = first; k < count; k++) seen[g->peers[k]] = 0;
+        seen[cell] = 0;
+    }
+    g->peerStart[g->cells] = count;
+    g->peers = realloc(g->peers, count * sizeof(int));
+    free(seen);
+    free(fill);
+
+    return g;
+}
+
+// Function to get the lookup tables of a classic board; they are built on first use and kept
+const Geometry *geometry_get(int n, int boxRows) {
+    return geometry_variant(n, boxRows, VARIANT_CLASSIC);
+}
+
+// Function to get the lookup tables of a board with the extra constraints of a variant
+const Geometry *geometry_variant(int n, int boxRows, int flags) {
+    if (cache[flags][n][boxRows] == NULL)
+        cache[flags][n][boxRows] = buildGeometry(n, boxRows, flags);
+    return cache[flags][n][boxRows];
+}
+
+// Function to get the lookup tables for the current board size and variant
+const Geometry *geometry_current() {
+    return geometry_variant(size, sub, variant);
+}
+
+// Function to read variant flags written as "classic" or a comma separated list of x, windoku and knight.
+// Returns -1 for an unknown name.
+int variant_parse(const char *text) {
+    if (strcmp(text, "classic") == 0)
+        return VARIANT_CLASSIC;
+    int flags = 0;
+    while (*text) {
+        size_t len = strcspn(text, ",");
+        int known = 0;
+        for (int b = 0; b < 3; b++) {
+            if (strlen(variantNames[b]) == len && strncmp(text, variantNames[b], len) == 0) {
+                flags |= 1 << b;
+                known = 1;
+            }
+        }
+        if (!known)
+            return -1;
+        text += len;
+        if (*text == ',') text++;
+    }
+    return flags;
+}
+
+// Function to describe variant flags for the player, e.g. "x, windoku"
+const char *variant_describe(int flags) {
+    static char text[32];
+    text[0] = '\0';
+    for (int b = 0; b < 3; b++) {
+        if (flags & (1 << b)) {
+            if (text[0]) strcat(text, ", ");
+            strcat(text, variantNames[b]);
+        }
+    }
+    return text[0] ? text : "classic";
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sudoku.h"
+
+#define MC_MAX_ITER 200000      // Default budget of moves
+#define MC_TABU_TENURE 3        // Moves during which a cell may not take back its old value
+#define MC_RESTART_AFTER 2000   // Moves without a new best state before a random restart
+
+// Picks a random unfixed cell that is in conflict; returns -1 if there is none
+static int pick_conflicting_cell(const SudokuState *state) {
+    int cells = size * size;
+    int start = rng_next() % cells;
+    for (int k = 0; k < cells; k++) {
+        int cell = (start + k) % cells;
+        if (!state->fixed[cell] && unit_counts_cell_conflicts(&state->counts, state->grid, cell) > 0)
+            return cell;
+    }
+    return -1;
+}
+
+// Min-conflicts local search with a tabu list: repeatedly moves a conflicting cell
+// by the best swap inside its block that is not tabu (unless it beats the best state)
+SolveResult runMC(int **board, const SolveLimits *limits) {
+    PERF_BEGIN(runPerf);
+    const Geometry *g = geometry_current();
+    SolveProgress progress;
+    solve_begin(&progress, limits, MC_MAX_ITER);
+    SolveStatus status = SOLVE_RUNNING;
+
+    SudokuState current_state, best_state;
+    alloc_state(&current_state);
+    alloc_state(&best_state);
+    load_state(&current_state, board);
+    TRACE_BEGIN(setup);
+    initialize_state(&current_state);
+    TRACE_END(setup, "MC setup");
+    copy_state(&best_state, &current_state);
+    metrics_phase(PHASE_SETUP, solver_clock() - progress.start);
+
+    // tabu[cell * (size + 1) + v] = first move at which the cell may take value v again
+    long long *tabu = calloc(size * size * (size + 1), sizeof(long long));
+    long long iter, last_improvement = 0;
+
+    for (iter = 0; best_state.energy > 0; iter++) {
+        progress.iterations = iter;
+        if ((status = solve_check(&progress)) != SOLVE_RUNNING)
+            break;  // Deadline, budget or cancellation
+
+        // Random restart from the puzzle when the search stops improving
+        if (iter - last_improvement > MC_RESTART_AFTER) {
+            for (int c = 0; c < size * size; c++)
+                if (!current_state.fixed[c]) current_state.grid[c] = 0;
+            initialize_state(&current_state);
+            memset(tabu, 0, size * size * (size + 1) * sizeof(long long));
+            last_improvement = iter;
+            metrics_add(METRIC_MC_RESTARTS, 1);
+        }
+
+        int cell = pick_conflicting_cell(&current_state);
+        if (cell < 0) break;  // Unfixed cells are conflict free, only the givens clash
+
+        int box = g->cellUnits[cell * UNITS_PER_CELL + 2] - 2 * size;
+        const int *partners = &current_state.movable[box * size];
+        int best_partner = -1, best_delta = 0;
+
+        // Score every swap partner in the block
+        for (int k = 0; k < current_state.movable_count[box]; k++) {
+            int other = partners[k];
+            if (other == cell) continue;
+            int delta = unit_counts_swap_delta(&current_state.counts, current_state.grid, cell, other);
+
+            int is_tabu = tabu[cell * (size + 1) + current_state.grid[other]] > iter ||
+                          tabu[other * (size + 1) + current_state.grid[cell]] > iter;
+            int aspiration = current_state.energy + delta < best_state.energy;
+            if (is_tabu && !aspiration) continue;
+
+            if (best_partner < 0 || delta < best_delta || (delta == best_delta && rng_next() % 2)) {
+                best_partner = other;
+                best_delta = delta;
+            }
+        }
+        if (best_partner < 0) continue;  // Every move is tabu
+
+        // Forbid both cells from taking back their old values for a while
+        tabu[cell * (size + 1) + current_state.grid[cell]] = iter + MC_TABU_TENURE;
+        tabu[best_partner * (size + 1) + current_state.grid[best_partner]] = iter + MC_TABU_TENURE;
+        unit_counts_swap(&current_state.counts, current_state.grid, cell, best_partner);
+        current_state.energy += best_delta;
+        metrics_add(METRIC_MC_MOVES, 1);
+
+        if (current_state.energy < best_state.energy) {
+            copy_state(&best_state, &current_state);
+            last_improvement = iter;
+        }
+    }
+
+    progress.iterations = iter;
+    for (int i = 0; i < size; i++)
+        for (int j = 0; j < size; j++)
+            board[i][j] = best_state.grid[i * size + j];
+
+    SolveResult result = solve_finish(&progress, status, best_state.energy);
+    free(tabu);
+    free_state(&current_state);
+    free_state(&best_state);
+    PERF_END(runPerf, PERF_MC, 1);
+    return result;
+}
@@ -0,0 +1,181 @@
+#define _XOPEN_SOURCE 700  // SA_RESTART
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include "sudoku.h"
+
+#define METRICS_MAX_THREADS 256      // Slots; the last one is shared by any threads beyond it
+#define METRICS_POLL_NANOS 100000000 // The exporter wakes up every 0.1 s to look for work
+
+static MetricsSlot slots[METRICS_MAX_THREADS];
+static atomic_int slotCount = 0;
+_Thread_local MetricsSlot *metricsSlot = NULL;
+
+static const char *counterNames[METRIC_COUNT] = {
+    "search_nodes", "backtracks", "propagations", "sa_accepted_moves", "sa_rejected_moves",
+    "mc_moves", "mc_restarts", "ga_evaluations", "ga_generations", "ga_restarts",
+    "sat_decisions", "sat_conflicts", "solver_runs", "solver_solved"
+};
+
+static const char *counterHelp[METRIC_COUNT] = {
+    "Backtracking placements", "Backtracking placements taken back", "Batch propagation passes",
+    "Simulated annealing moves accepted", "Simulated annealing moves rejected", "Min-conflicts moves",
+    "Min-conflicts random restarts", "Genetic algorithm fitness evaluations", "Genetic algorithm generations",
+    "Genetic algorithm population restarts", "CDCL SAT decisions", "CDCL SAT conflicts",
+    "Finished solver runs", "Solver runs that solved their board"
+};
+
+static const char *phaseNames[PHASE_COUNT] = {"setup", "solve", "propagate", "fallback"};
+
+// Function to give the calling thread its own slot (called once per thread)
+MetricsSlot *metrics_register() {
+    int index = atomic_fetch_add(&slotCount, 1);
+    if (index >= METRICS_MAX_THREADS - 1) {
+        index = METRICS_MAX_THREADS - 1;
+        slots[index].shared = 1;  // Set before any thread bumps it: the overflow slot is never used privately
+    }
+    metricsSlot = &slots[index];
+    return metricsSlot;
+}
+
+// Function to add the time spent in a phase to the calling thread's slot
+void metrics_phase(MetricPhase phase, double seconds) {
+    MetricsSlot *slot = metricsSlot != NULL ? metricsSlot : metrics_register();
+    metrics_bump(&slot->phaseNanos[phase], (unsigned long long) (seconds * 1e9), slot->shared);
+}
+
+// Function to add up the slots of all threads; returns the number of threads that counted
+int metrics_snapshot(unsigned long long counters[METRIC_COUNT], double phaseSeconds[PHASE_COUNT]) {
+    int used = atomic_load(&slotCount);
+    int n = used < METRICS_MAX_THREADS ? used : METRICS_MAX_THREADS;
+    for (int c = 0; c < METRIC_COUNT; c++) counters[c] = 0;
+    for (int p = 0; p < PHASE_COUNT; p++) phaseSeconds[p] = 0;
+
+    for (int t = 0; t < n; t++) {
+        for (int c = 0; c < METRIC_COUNT; c++)
+            counters[c] += atomic_load_explicit(&slots[t].counter[c], memory_order_relaxed);
+        for (int p = 0; p < PHASE_COUNT; p++)
+            phaseSeconds[p] += atomic_load_explicit(&slots[t].phaseNanos[p], memory_order_relaxed) / 1e9;
+    }
+    return used;
+}
+
+// Function to write the current totals as Prometheus text or JSON
+void metrics_write(FILE *out, MetricsFormat format) {
+    unsigned long long counters[METRIC_COUNT];
+    double phases[PHASE_COUNT];
+    int threads = metrics_snapshot(counters, phases);
+
+    if (format == METRICS_JSON) {
+        fprintf(out, "{\"threads\": %d, \"counters\": {", threads);
+        for (int c = 0; c < METRIC_COUNT; c++)
+            fprintf(out, "%s\"%s\": %llu", c ? ", " : "", counterNames[c], counters[c]);
+        fprintf(out, "}, \"phase_seconds\": {");
+        for (int p = 0; p < PHASE_COUNT; p++)
+            fprintf(out, "%s\"%s\": %.6f", p ? ", " : "", phaseNames[p], phases[p]);
+        fprintf(out, "}}\n");
+        return;
+    }
+
+    for (int c = 0; c < METRIC_COUNT; c++) {
+        fprintf(out, "# HELP sudoku_%s_total %s\n", counterNames[c], counterHelp[c]);
+        fprintf(out, "# TYPE sudoku_%s_total counter\n", counterNames[c]);
+        fprintf(out, "sudoku_%s_total %llu\n", counterNames[c], counters[c]);
+    }
+    fprintf(out, "# HELP sudoku_phase_seconds_total Time spent in each solver phase\n");
+    fprintf(out, "# TYPE sudoku_phase_seconds_total counter\n");
+    for (int p = 0; p < PHASE_COUNT; p++)
+        fprintf(out, "sudoku_phase_seconds_total{phase=\"%s\"} %.6f\n", phaseNames[p], phases[p]);
+    fprintf(out, "# HELP sudoku_metrics_threads Threads that reported counters\n");
+    fprintf(out, "# TYPE sudoku_metrics_threads gauge\n");
+    fprintf(out, "sudoku_metrics_threads %d\n", threads);
+}
+
+// Function to write the totals to a file ("-" = standard output). The file is written under
+// a temporary name and renamed, so a reader never sees half an export. Returns 0 on error.
+int metrics_export(const char *path, MetricsFormat format) {
+    if (strcmp(path, "-") == 0) {
+        metrics_write(stdout, format);
+        fflush(stdout);
+        return 1;
+    }
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *file = fopen(tmp, "w");
+    if (file == NULL)
+        return 0;
+    metrics_write(file, format);
+    fclose(file);
+    return rename(tmp, path) == 0;
+}
+
+// Settings of the background exporter
+static struct {
+    char path[4096];
+    MetricsFormat format;
+    double interval;     // Seconds between exports (0 = only on request and at stop)
+    atomic_int stop;
+    int running;
+    pthread_t thread;
+} exporter;
+
+static volatile sig_atomic_t exportRequested = 0;
+
+// Signal handler: SIGUSR1 asks for an export right away
+static void requestExport(int signo) {
+    (void) signo;
+    exportRequested = 1;
+}
+
+// Thread function: export at every interval and whenever SIGUSR1 arrives
+static void *exportLoop(void *arg) {
+    (void) arg;
+    double next = exporter.interval > 0 ? solver_clock() + exporter.interval : 0;
+    struct timespec poll = {0, METRICS_POLL_NANOS};
+
+    while (!atomic_load(&exporter.stop)) {
+        nanosleep(&poll, NULL);
+        if (exportRequested || (next > 0 && solver_clock() >= next)) {
+            exportRequested = 0;
+            metrics_export(exporter.path, exporter.format);
+            if (next > 0) next = solver_clock() + exporter.interval;
+        }
+    }
+    return NULL;
+}
+
+// Function to start exporting the counters in the background; returns 0 if already running
+int metrics_start(const char *path, MetricsFormat format, double interval) {
+    if (exporter.running)
+        return 0;
+    snprintf(exporter.path, sizeof(exporter.path), "%s", path);
+    exporter.format = format;
+    exporter.interval = interval;
+    atomic_store(&exporter.stop, 0);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestExport;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &action, NULL);
+
+    if (pthread_create(&exporter.thread, NULL, exportLoop, NULL) != 0)
+        return 0;
+    exporter.running = 1;
+    return 1;
+}
+
+// Function to stop the background exporter after one final export
+void metrics_stop() {
+    if (!exporter.running)
+        return;
+    atomic_store(&exporter.stop, 1);
+    pthread_join(exporter.thread, NULL);
+    exporter.running = 0;
+    metrics_export(exporter.path, exporter.format);
+}
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sudoku.h"
+
+int searchThreads = 0;  // Threads of the parallel search (0 = one per CPU)
+
+// One level of a worker's depth-first search
+typedef struct {
+    int cell;
+    int value;                  // Digit placed in the cell, 0 before the first one
+    atomic_ullong remaining;    // Candidates not tried yet; a thief takes them all at once
+} SearchFrame;
+
+struct ParallelSearch;
+
+// One thread of the search with its own stack. The board below the stack is its base; the board
+// at any frame is the base plus the values of the frames under it, which is all a thief has to copy.
+typedef struct {
+    struct ParallelSearch *s;
+    int index;
+    pthread_mutex_t lock;       // Held by thieves, and by the owner whenever it pops a frame
+    cell_t *base;
+    SearchFrame *frames;
+    atomic_int top;             // Frames on the stack
+    cell_t *grid;               // Current board
+    DigitSet *used;             // used[u] = digits placed in unit u
+    int *empty;                 // Empty cells of the base; empty[k] is the cell of frame k
+    int emptyCount;
+    long long steals;
+    SolveProgress progress;
+    SolveStatus status;         // Limit that stopped this thread, SOLVE_RUNNING otherwise
+} SearchWorker;
+
+typedef struct ParallelSearch {
+    const Geometry *geom;
+    SearchWorker *workers;
+    int threads;
+    atomic_int active;          // Workers with frames on their stack
+    atomic_int stop;            // Set once a solution is found or a limit is hit
+    atomic_int winner;          // Worker that found the solution, -1 while there is none
+    cell_t *solution;
+    const SolveLimits *limits;
+} ParallelSearch;
+
+// Function to give a worker the board in its base and one frame with the candidates of a cell
+static void startStack(SearchWorker *w, int cell, DigitSet candidates) {
+    const Geometry *g = w->s->geom;
+    memcpy(w->grid, w->base, g->cells);
+    digit_masks_load(g, w->grid, w->used, w->empty, &w->emptyCount);
+    for (int k = 0; k < w->emptyCount; k++) {
+        if (w->empty[k] == cell) {  // The frame's cell comes first in the list
+            w->empty[k] = w->empty[0];
+            w->empty[0] = cell;
+            break;
+        }
+    }
+    w->frames[0].cell = cell;
+    w->frames[0].value = 0;
+    atomic_store_explicit(&w->frames[0].remaining, candidates, memory_order_relaxed);
+    atomic_store_explicit(&w->top, 1, memory_order_release);
+}
+
+// Function to take the untried candidates of the shallowest frame of another worker's stack.
+// Returns 1 if the calling worker got work.
+static int stealWork(SearchWorker *w) {
+    ParallelSearch *s = w->s;
+    const Geometry *g = s->geom;
+    for (int k = 1; k < s->threads; k++) {
+        SearchWorker *victim = &s->workers[(w->index + k) % s->threads];
+        if (atomic_load_explicit(&victim->top, memory_order_relaxed) == 0)
+            continue;
+
+        pthread_mutex_lock(&victim->lock);
+        // With the lock held the victim cannot pop, so the frames under the stolen one stay put
+        int top = atomic_load_explicit(&victim->top, memory_order_acquire);
+        for (int f = 0; f < top; f++) {
+            SearchFrame *frame = &victim->frames[f];
+            DigitSet stolen;
+            if (atomic_load_explicit(&frame->remaining, memory_order_relaxed) == 0 ||
+                (stolen = atomic_exchange_explicit(&frame->remaining, 0, memory_order_relaxed)) == 0)
+                continue;
+            int cell = frame->cell;
+            memcpy(w->base, victim->base, g->cells);
+            for (int j = 0; j < f; j++)
+                w->base[victim->frames[j].cell] = victim->frames[j].value;
+            atomic_fetch_add(&s->active, 1);  // Still under the lock: the search cannot look finished meanwhile
+            pthread_mutex_unlock(&victim->lock);
+
+            startStack(w, cell, stolen);
+            w->steals++;
+            return 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return 0;
+}
+
+// Function to run the depth-first search on the worker's stack until it is empty or the search stops
+static void searchStack(SearchWorker *w) {
+    ParallelSearch *s = w->s;
+    const Geometry *g = s->geom;
+    int top = atomic_load_explicit(&w->top, memory_order_relaxed);
+
+    while (top > 0) {
+        SearchFrame *frame = &w->frames[top - 1];
+        if (frame->value) {  // Take back the previous value of the cell
+            digit_masks_flip(g, w->used, frame->cell, DIGIT_BIT(frame->value));
+            w->grid[frame->cell] = 0;
+            frame->value = 0;
+            metrics_add(METRIC_BACKTRACKS, 1);
+        }
+
+        // Next candidate of the frame; a thief may take the rest at any moment
+        DigitSet rest = atomic_load_explicit(&frame->remaining, memory_order_relaxed);
+        while (rest && !atomic_compare_exchange_weak_explicit(&frame->remaining, &rest, rest & (rest - 1),
+                                                              memory_order_relaxed, memory_order_relaxed));
+        if (rest == 0) {
+            pthread_mutex_lock(&w->lock);
+            atomic_store_explicit(&w->top, --top, memory_order_relaxed);
+            if (top == 0)
+                atomic_fetch_sub(&s->active, 1);
+            pthread_mutex_unlock(&w->lock);
+            continue;
+        }
+
+        if (atomic_load_explicit(&s->stop, memory_order_relaxed))
+            return;
+        SolveStatus status = solve_check(&w->progress);
+        if (status != SOLVE_RUNNING) {
+            w->status = status;
+            atomic_store(&s->stop, 1);
+            return;
+        }
+        w->progress.iterations++;
+        metrics_add(METRIC_NODES, 1);
+
+        DigitSet bit = rest & -rest;
+        frame->value = __builtin_ctzll(bit) + 1;
+        w->grid[frame->cell] = frame->value;
+        digit_masks_flip(g, w->used, frame->cell, bit);
+
+        if (top == w->emptyCount) {  // Every cell is filled
+            int expected = -1;
+            if (atomic_compare_exchange_strong(&s->winner, &expected, w->index))
+                memcpy(s->solution, w->grid, g->cells);
+            atomic_store(&s->stop, 1);
+            return;
+        }
+        DigitSet candidates = digit_masks_pick(g, w->grid, w->used, w->empty, w->emptyCount, top);
+        if (candidates == 0)
+            continue;  // Dead end: try the next value of this frame
+
+        SearchFrame *next = &w->frames[top];
+        next->cell = w->empty[top];
+        next->value = 0;
+        atomic_store_explicit(&next->remaining, candidates, memory_order_relaxed);
+        atomic_store_explicit(&w->top, ++top, memory_order_release);
+    }
+}
+
+// Thread function: search the own stack, and steal from the others whenever it is empty
+static void *searchWorker(void *arg) {
+    SearchWorker *w = arg;
+    ParallelSearch *s = w->s;
+    TRACE_THREAD("parallel search");
+
+    while (!atomic_load_explicit(&s->stop, memory_order_relaxed)) {
+        if (atomic_load_explicit(&w->top, memory_order_relaxed) == 0 && !stealWork(w)) {
+            if (atomic_load(&s->active) == 0)
+                break;  // Nobody has work left: every branch was searched
+            sched_yield();
+            continue;
+        }
+        TRACE_BEGIN(branch);
+        searchStack(w);
+        TRACE_END(branch, "search branch");
+    }
+    return NULL;
+}
+
+// Function to solve a puzzle with a depth-first search spread over several threads (threads <= 0
+// uses every core). Idle threads steal the untried candidates of the shallowest frame of a busy thread,
+// and all threads stop as soon as one of them fills the board. The limits apply to every thread;
+// iteration budgets are per thread. The energy of the result is the number of cells left empty.
+SolveResult solveParallel(int **board, int threads, const SolveLimits *limits) {
+    SolveProgress progress;
+    solve_begin(&progress, limits, 0);
+    if (threads <= 0)
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0)
+        threads = 1;
+
+    ParallelSearch s;
+    s.geom = geometry_current();
+    s.threads = threads;
+    s.limits = limits;
+    s.solution = malloc(s.geom->cells);
+    atomic_init(&s.active, 0);
+    atomic_init(&s.stop, 0);
+    atomic_init(&s.winner, -1);
+    s.workers = malloc(threads * sizeof(SearchWorker));
+    for (int t = 0; t < threads; t++) {
+        SearchWorker *w = &s.workers[t];
+        w->s = &s;
+        w->index = t;
+        pthread_mutex_init(&w->lock, NULL);
+        w->base = malloc(s.geom->cells);
+        w->frames = malloc(s.geom->cells * sizeof(SearchFrame));
+        atomic_init(&w->top, 0);
+        w->grid = malloc(s.geom->cells);
+        w->used = malloc(s.geom->units * sizeof(DigitSet));
+        w->empty = malloc(s.geom->cells * sizeof(int));
+        w->steals = 0;
+        w->status = SOLVE_RUNNING;
+        solve_begin(&w->progress, limits, 0);  // Also for workers whose thread is never started
+    }
+
+    // The first worker starts with the whole puzzle
+    SearchWorker *first = &s.workers[0];
+    int empty = 0;
+    for (int cell = 0; cell < s.geom->cells; cell++) {
+        first->base[cell] = board[s.geom->cellRow[cell]][s.geom->cellCol[cell]];
+        if (first->base[cell] == 0) empty++;
+    }
+    if (digit_masks_load(s.geom, first->base, first->used, first->empty, &first->emptyCount)) {
+        if (first->emptyCount == 0) {
+            memcpy(s.solution, first->base, s.geom->cells);
+            atomic_store(&s.winner, 0);
+        } else {
+            DigitSet candidates = digit_masks_pick(s.geom, first->base, first->used, first->empty, first->emptyCount, 0);
+            if (candidates) {
+                atomic_store(&s.active, 1);
+                startStack(first, first->empty[0], candidates);
+            }
+        }
+    }
+
+    TRACE_BEGIN(search);
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    if (atomic_load(&s.active) > 0) {
+        for (int t = 0; t < threads; t++)
+            pthread_create(&ids[t], NULL, searchWorker, &s.workers[t]);
+        for (int t = 0; t < threads; t++)
+            pthread_join(ids[t], NULL);
+    }
+    TRACE_END(search, "parallel search");
+
+    SolveStatus status = SOLVE_RUNNING;
+    long long steals = 0;
+    for (int t = 0; t < threads; t++) {
+        SearchWorker *w = &s.workers[t];
+        progress.iterations += w->progress.iterations;
+        steals += w->steals;
+        if (w->status != SOLVE_RUNNING)
+            status = w->status;
+        pthread_mutex_destroy(&w->lock);
+        free(w->base);
+        free(w->frames);
+        free(w->grid);
+        free(w->used);
+        free(w->empty);
+    }
+    if (atomic_load(&s.winner) >= 0) {
+        for (int cell = 0; cell < s.geom->cells; cell++)
+            board[s.geom->cellRow[cell]][s.geom->cellCol[cell]] = s.solution[cell];
+        empty = 0;
+    } else if (empty == 0) {
+        empty = 1;  // Full board with conflicting givens
+    }
+    printf("Parallel search: %d threads, %lld steals\n", threads, steals);
+
+    free(ids);
+    free(s.workers);
+    free(s.solution);
+    return solve_finish(&progress, status, empty);
+}
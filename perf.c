@@ -0,0 +1,206 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // syscall
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sudoku.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+int perfEnabled = 0;  // Set by perf_start (--perf); the PERF_ macros do nothing until then
+
+static const char *regionNames[PERF_REGION_COUNT] = {
+    "fill", "backtrack", "sa", "ga", "ga_generation", "mc"
+};
+static const char *eventNames[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "cache_misses", "branch_misses"
+};
+
+// Sums over all calls of one region
+typedef struct {
+    long long calls;
+    double seconds;
+    unsigned long long value[PERF_EVENT_COUNT];
+    unsigned valid;  // Events counted in every call
+} PerfTotal;
+
+static pthread_mutex_t perfLock = PTHREAD_MUTEX_INITIALIZER;  // Guards the totals and the output
+static PerfTotal totals[PERF_REGION_COUNT];
+static FILE *perfOut = NULL;
+
+#ifdef __linux__
+
+// Counters of one thread, opened as one group so they start and stop together
+typedef struct {
+    int leader;                       // -1 if no event could be opened
+    int fd[PERF_EVENT_COUNT];
+    int slot[PERF_EVENT_COUNT];       // Position of every event in a group read, -1 if it is not counted
+    int opened;
+} PerfCounters;
+
+static const unsigned long long eventConfigs[PERF_EVENT_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static _Thread_local PerfCounters *threadCounters = NULL;
+static pthread_key_t countersKey;
+static pthread_once_t countersOnce = PTHREAD_ONCE_INIT;
+
+// Function to close the counters of a thread when it exits
+static void closeCounters(void *arg) {
+    PerfCounters *counters = arg;
+    for (int e = PERF_EVENT_COUNT - 1; e >= 0; e--)
+        if (counters->fd[e] >= 0) close(counters->fd[e]);
+    free(counters);
+}
+
+static void createKey() {
+    pthread_key_create(&countersKey, closeCounters);
+}
+
+// Function to open the counters of the calling thread on first use. They count this thread in
+// user space only, which is all perf_event_paranoid 2 allows.
+static PerfCounters *openCounters() {
+    if (threadCounters != NULL)
+        return threadCounters;
+    PerfCounters *counters = malloc(sizeof(PerfCounters));
+    counters->leader = -1;
+    counters->opened = 0;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = eventConfigs[e];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.disabled = counters->leader < 0;  // The leader starts the whole group
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        counters->fd[e] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, counters->leader, 0);
+        counters->slot[e] = counters->fd[e] >= 0 ? counters->opened++ : -1;
+        if (counters->fd[e] >= 0 && counters->leader < 0)
+            counters->leader = counters->fd[e];
+    }
+    if (counters->leader >= 0)
+        ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    pthread_once(&countersOnce, createKey);
+    pthread_setspecific(countersKey, counters);
+    threadCounters = counters;
+    return counters;
+}
+
+// Function to read the counters of the calling thread, scaled up when the kernel had to multiplex them.
+// Returns the mask of the events that were read.
+static unsigned readCounters(unsigned long long value[PERF_EVENT_COUNT]) {
+    PerfCounters *counters = openCounters();
+    unsigned long long data[3 + PERF_EVENT_COUNT];  // nr, time enabled, time running, values
+    if (counters->leader < 0 || read(counters->leader, data, sizeof(data)) < (ssize_t) (3 * sizeof(data[0])))
+        return 0;
+    double scale = data[2] > 0 ? (double) data[1] / data[2] : 0;
+    unsigned valid = 0;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (counters->slot[e] < 0 || data[2] == 0)
+            continue;
+        value[e] = (unsigned long long) (data[3 + counters->slot[e]] * scale);
+        valid |= 1u << e;
+    }
+    return valid;
+}
+
+#else
+
+// Hardware counters need perf_event_open: elsewhere only wall time is measured
+static unsigned readCounters(unsigned long long value[PERF_EVENT_COUNT]) {
+    (void) value;
+    return 0;
+}
+
+#endif
+
+// Function to print the counters of a measurement, with instructions per cycle and misses per 1000 instructions
+static void writeCounters(const unsigned long long value[PERF_EVENT_COUNT], unsigned valid) {
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        if (!(valid & (1u << e))) {
+            fprintf(perfOut, ", %s n/a", eventNames[e]);
+            continue;
+        }
+        fprintf(perfOut, ", %s %llu", eventNames[e], value[e]);
+        if (e == PERF_INSTRUCTIONS && (valid & (1u << PERF_CYCLES)) && value[PERF_CYCLES] > 0)
+            fprintf(perfOut, " (IPC %.2f)", (double) value[e] / value[PERF_CYCLES]);
+        else if (e > PERF_INSTRUCTIONS && (valid & (1u << PERF_INSTRUCTIONS)) && value[PERF_INSTRUCTIONS] > 0)
+            fprintf(perfOut, " (%.2f per 1k instructions)", 1000.0 * value[e] / value[PERF_INSTRUCTIONS]);
+    }
+    fprintf(perfOut, "\n");
+}
+
+// Function to start a measurement of the calling thread
+void perf_begin(PerfSample *sample) {
+    sample->valid = readCounters(sample->value);
+    sample->start = solver_clock();
+}
+
+// Function to end a measurement, add it to the totals of its region and, with report set, print it
+// as a line of its own (one per puzzle for the solver calls)
+void perf_end(PerfSample *sample, PerfRegion region, int report) {
+    unsigned long long now[PERF_EVENT_COUNT];
+    double seconds = solver_clock() - sample->start;
+    unsigned valid = readCounters(now) & sample->valid;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++)
+        now[e] = valid & (1u << e) ? now[e] - sample->value[e] : 0;
+
+    pthread_mutex_lock(&perfLock);
+    PerfTotal *total = &totals[region];
+    total->valid = total->calls == 0 ? valid : total->valid & valid;
+    total->calls++;
+    total->seconds += seconds;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++)
+        total->value[e] += now[e];
+    if (report && perfOut != NULL) {
+        fprintf(perfOut, "perf %s: %.6f s", regionNames[region], seconds);
+        writeCounters(now, valid);
+        fflush(perfOut);
+    }
+    pthread_mutex_unlock(&perfLock);
+}
+
+// Function to start measuring the solver hot paths; per-call lines and the totals at exit go to the
+// file (or standard output for "-"). Returns 0 if the file cannot be opened.
+int perf_start(const char *path) {
+    perfOut = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (perfOut == NULL) {
+        printf("Error opening %s for writing.\n", path);
+        return 0;
+    }
+    unsigned long long value[PERF_EVENT_COUNT];
+    if (readCounters(value) == 0)
+        fprintf(stderr, "Hardware counters are not available (perf_event_open); only wall time is measured.\n");
+    perfEnabled = 1;
+    return 1;
+}
+
+// Function to write the totals of every region that ran and stop measuring
+void perf_stop() {
+    if (!perfEnabled)
+        return;
+    perfEnabled = 0;
+    pthread_mutex_lock(&perfLock);
+    for (int r = 0; r < PERF_REGION_COUNT; r++) {
+        if (totals[r].calls == 0)
+            continue;
+        fprintf(perfOut, "perf total %s: %lld calls, %.6f s", regionNames[r], totals[r].calls, totals[r].seconds);
+        writeCounters(totals[r].value, totals[r].valid);
+    }
+    if (perfOut != stdout)
+        fclose(perfOut);
+    else
+        fflush(perfOut);
+    perfOut = NULL;
+    pthread_mutex_unlock(&perfLock);
+}
@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sudoku.h"
+
+#define PIPELINE_QUEUE 64     // Slots of each ring buffer (a power of two)
+#define PIPELINE_WINDOW 256   // Chunks the parser may run ahead of the writer
+#define PIPELINE_SPINS 64     // Yields before a waiting thread starts to sleep
+#define PIPELINE_NAP_NANOS 50000
+
+// Result of one game
+enum { GAME_UNSOLVABLE = 0, GAME_PROPAGATED = 1, GAME_BACKTRACKED = 2, GAME_UNSUPPORTED = 3 };
+
+// One game read from the input
+typedef struct {
+    int n, boxRows, hints;
+    int *cells, *fixed;   // n * n each
+    int result;
+} PipelineGame;
+
+// Up to BATCH_LANES consecutive games travelling through the pipeline together
+typedef struct {
+    long seq;             // Position in the input, used by the writer to restore the order
+    int count;
+    PipelineGame games[BATCH_LANES];
+} PipelineChunk;
+
+// Bounded lock-free multi-producer multi-consumer ring buffer (Vyukov's algorithm): every slot carries
+// a sequence number telling whether it is ready to be written or read in the current lap.
+typedef struct {
+    atomic_size_t seq;
+    void *data;
+} RingSlot;
+
+typedef struct {
+    RingSlot slots[PIPELINE_QUEUE];
+    _Alignas(64) atomic_size_t head;  // Next slot to read
+    _Alignas(64) atomic_size_t tail;  // Next slot to write
+} RingQueue;
+
+// Function to set up an empty ring buffer
+static void ring_init(RingQueue *q) {
+    for (size_t i = 0; i < PIPELINE_QUEUE; i++)
+        atomic_init(&q->slots[i].seq, i);
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+}
+
+// Function to add an item; returns 0 if the buffer is full
+static int ring_push(RingQueue *q, void *data) {
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    RingSlot *slot;
+    while (1) {
+        slot = &q->slots[pos & (PIPELINE_QUEUE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        long diff = (long) seq - (long) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return 0;  // Slot still holds an item of the previous lap
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+    slot->data = data;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    return 1;
+}
+
+// Function to take the oldest item; returns NULL if the buffer is empty
+static void *ring_pop(RingQueue *q) {
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    RingSlot *slot;
+    while (1) {
+        slot = &q->slots[pos & (PIPELINE_QUEUE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        long diff = (long) seq - (long) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return NULL;  // Nothing written to this slot yet
+        } else {
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+        }
+    }
+    void *data = slot->data;
+    atomic_store_explicit(&slot->seq, pos + PIPELINE_QUEUE, memory_order_release);
+    return data;
+}
+
+// Function to wait a little longer each time a queue is full or empty
+static void backoff(int *spins) {
+    if (++*spins < PIPELINE_SPINS) {
+        sched_yield();
+    } else {
+        struct timespec nap = {0, PIPELINE_NAP_NANOS};
+        nanosleep(&nap, NULL);
+    }
+}
+
+// Function to add an item, waiting while the buffer is full (backpressure on the producer)
+static void ring_push_wait(RingQueue *q, void *data) {
+    int spins = 0;
+    while (!ring_push(q, data)) backoff(&spins);
+}
+
+// Function to take an item, waiting while the buffer is empty
+static void *ring_pop_wait(RingQueue *q) {
+    int spins = 0;
+    void *data;
+    while ((data = ring_pop(q)) == NULL) backoff(&spins);
+    return data;
+}
+
+static struct {
+    FILE *in, *out;
+    int workers;
+    RingQueue parsed;   // Parser -> solvers
+    RingQueue solved;   // Solvers -> writer
+    PipelineChunk done; // Pushed once by every solver when it stops
+    atomic_long written; // Chunks written so far
+    int stats[4];       // Games per result
+} pipeline;
+
+// Parser thread: read the games, group them in chunks and hand them to the solvers
+static void *parseStage(void *arg) {
+    (void) arg;
+    TRACE_THREAD("pipeline parser");
+    long seq = 0;
+    int more = 1;
+    while (more) {
+        TRACE_BEGIN(parse);
+        PipelineChunk *chunk = malloc(sizeof(PipelineChunk));
+        chunk->seq = seq;
+        chunk->count = 0;
+        while (chunk->count < BATCH_LANES) {
+            PipelineGame *game = &chunk->games[chunk->count];
+            if (!scanGame(pipeline.in, &game->n, &game->boxRows, &game->hints, &game->cells, &game->fixed)) {
+                more = 0;  // End of the input (or a game that cannot be read)
+                break;
+            }
+            chunk->count++;
+        }
+        TRACE_END(parse, "pipeline parse");
+        if (chunk->count == 0) {
+            free(chunk);
+            break;
+        }
+        // A slow chunk holds back the writer: do not read more than the reorder window ahead of it
+        int spins = 0;
+        while (seq - atomic_load(&pipeline.written) >= PIPELINE_WINDOW) backoff(&spins);
+        seq++;
+        ring_push_wait(&pipeline.parsed, chunk);
+    }
+
+    // One stop marker per solver
+    for (int w = 0; w < pipeline.workers; w++)
+        ring_push_wait(&pipeline.parsed, &pipeline.done);
+    return NULL;
+}
+
+// Solver thread: solve the 9x9 games of each chunk in one SIMD batch
+static void *solveStage(void *arg) {
+    (void) arg;
+    TRACE_THREAD("pipeline solver");
+    int puzzles[BATCH_LANES][BATCH_CELLS], solutions[BATCH_LANES][BATCH_CELLS], results[BATCH_LANES];
+    int lane[BATCH_LANES];
+
+    PipelineChunk *chunk;
+    while ((chunk = ring_pop_wait(&pipeline.parsed)) != &pipeline.done) {
+        TRACE_BEGIN(solve);
+        int count = 0;
+        for (int g = 0; g < chunk->count; g++) {
+            PipelineGame *game = &chunk->games[g];
+            game->result = GAME_UNSUPPORTED;
+            if (game->n == BATCH_SIZE && game->boxRows == 3) {
+                memcpy(puzzles[count], game->cells, sizeof(puzzles[count]));
+                lane[count++] = g;
+            }
+        }
+        batch_solve(puzzles, count, solutions, results);
+        for (int l = 0; l < count; l++) {
+            PipelineGame *game = &chunk->games[lane[l]];
+            game->result = results[l];
+            if (results[l] != GAME_UNSOLVABLE)
+                memcpy(game->cells, solutions[l], sizeof(solutions[l]));
+        }
+        TRACE_END(solve, "pipeline solve");
+        ring_push_wait(&pipeline.solved, chunk);
+    }
+    ring_push_wait(&pipeline.solved, &pipeline.done);
+    return NULL;
+}
+
+// Function to write one chunk and free it
+static void writeChunk(PipelineChunk *chunk) {
+    for (int g = 0; g < chunk->count; g++) {
+        PipelineGame *game = &chunk->games[g];
+        writeGameCells(pipeline.out, game->n, game->boxRows, game->hints, game->cells, game->fixed);
+        pipeline.stats[game->result]++;
+        free(game->cells);
+        free(game->fixed);
+    }
+    free(chunk);
+}
+
+// Writer thread: put the solved chunks back in input order. The parser stays less than
+// PIPELINE_WINDOW chunks ahead, so a window of that many slots is enough to reorder them.
+static void *writeStage(void *arg) {
+    (void) arg;
+    TRACE_THREAD("pipeline writer");
+    PipelineChunk *pending[PIPELINE_WINDOW] = {NULL};
+    long next = 0;
+    int stopped = 0;
+
+    while (stopped < pipeline.workers) {
+        PipelineChunk *chunk = ring_pop_wait(&pipeline.solved);
+        if (chunk == &pipeline.done) {
+            stopped++;
+            continue;
+        }
+        pending[chunk->seq % PIPELINE_WINDOW] = chunk;
+        TRACE_BEGIN(write);
+        while (pending[next % PIPELINE_WINDOW] != NULL) {
+            writeChunk(pending[next % PIPELINE_WINDOW]);
+            pending[next % PIPELINE_WINDOW] = NULL;
+            atomic_store(&pipeline.written, ++next);
+        }
+        TRACE_END(write, "pipeline write");
+    }
+    return NULL;
+}
+
+// Function to solve a file of saved games (as written by saveGame, one after another) with a parser
+// thread, a pool of solver threads and a writer thread that keeps the input order.
+// 9x9 games are solved in SIMD batches; games of other sizes are copied unchanged.
+int runPipeline(const char *inputPath, const char *outputPath, int workers) {
+    pipeline.in = fopen(inputPath, "r");
+    if (pipeline.in == NULL) {
+        printf("Error opening %s for reading.\n", inputPath);
+        return 1;
+    }
+    pipeline.out = fopen(outputPath, "w");
+    if (pipeline.out == NULL) {
+        printf("Error opening %s for writing.\n", outputPath);
+        fclose(pipeline.in);
+        return 1;
+    }
+
+    if (workers <= 0)
+        workers = (int) sysconf(_SC_NPROCESSORS_ONLN) - 2;  // The parser and the writer have their own threads
+    if (workers <= 0)
+        workers = 1;
+    pipeline.workers = workers;
+    ring_init(&pipeline.parsed);
+    ring_init(&pipeline.solved);
+    atomic_store(&pipeline.written, 0);
+    memset(pipeline.stats, 0, sizeof(pipeline.stats));
+    batch_prepare();
+    double start = solver_clock();
+
+    pthread_t parser, writer, *solvers = malloc(workers * sizeof(pthread_t));
+    pthread_create(&parser, NULL, parseStage, NULL);
+    for (int w = 0; w < workers; w++)
+        pthread_create(&solvers[w], NULL, solveStage, NULL);
+    pthread_create(&writer, NULL, writeStage, NULL);
+
+    pthread_join(parser, NULL);
+    for (int w = 0; w < workers; w++)
+        pthread_join(solvers[w], NULL);
+    pthread_join(writer, NULL);
+    free(solvers);
+
+    int stopped = !feof(pipeline.in);  // The parser stopped before the end of the file
+    fclose(pipeline.in);
+    fclose(pipeline.out);
+
+    int total = pipeline.stats[0] + pipeline.stats[1] + pipeline.stats[2] + pipeline.stats[3];
+    printf("Pipeline finished: %d games, %d solved by propagation, %d by backtracking, %d unsolvable, "
+           "%d not 9x9 (%d solver threads, %.3f s)\n", total, pipeline.stats[GAME_PROPAGATED],
+           pipeline.stats[GAME_BACKTRACKED], pipeline.stats[GAME_UNSOLVABLE], pipeline.stats[GAME_UNSUPPORTED],
+           workers, solver_clock() - start);
+    if (stopped)
+        printf("Stopped at game %d: it is not a valid saved game.\n", total + 1);
+    return stopped;
+}
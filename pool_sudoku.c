@@ -0,0 +1,152 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sudoku.h"
+
+#define POOL_SETTINGS 4  // Settings kept stocked at once; a new one replaces the least recently used
+#define POOL_DEPTH 4     // Ready puzzles per setting
+
+// Ready puzzles of one setting (board shape, variant and number of hints)
+typedef struct {
+    int n, boxRows, flags, hints;    // n == 0: slot not in use
+    const Geometry *geom;            // Built by the thread that asked for the setting
+    int count;
+    int *cells[POOL_DEPTH];          // n * n cells of each ready puzzle, 0 for empty
+    int *fixedCells[POOL_DEPTH];
+    unsigned long lastUse;           // Tick of the last request, to pick what to generate or replace
+    unsigned long serial;            // Changes whenever the slot is given to another setting
+} PoolSlot;
+
+// Puzzles are generated by one background thread, so New Game takes a ready one instead of waiting for
+// the backtracking fill (which can take seconds on 16x16 boards and variants)
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;             // A slot is short of puzzles
+    PoolSlot slots[POOL_SETTINGS];
+    unsigned long tick;
+    int started;
+    pthread_t generator;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+// Function to find the slot of a setting, taking over an unused or the least recently used slot
+// if there is none (pool lock held)
+static PoolSlot *findSlot(int n, int boxRows, int flags, int hints) {
+    PoolSlot *victim = &pool.slots[0];
+    for (int s = 0; s < POOL_SETTINGS; s++) {
+        PoolSlot *slot = &pool.slots[s];
+        if (slot->n == n && slot->boxRows == boxRows && slot->flags == flags && slot->hints == hints) {
+            slot->lastUse = ++pool.tick;
+            return slot;
+        }
+        if (slot->n == 0 || (victim->n != 0 && slot->lastUse < victim->lastUse))
+            victim = slot;
+    }
+
+    for (int i = 0; i < victim->count; i++) {
+        free(victim->cells[i]);
+        free(victim->fixedCells[i]);
+    }
+    victim->n = n;
+    victim->boxRows = boxRows;
+    victim->flags = flags;
+    victim->hints = hints;
+    victim->geom = geometry_variant(n, boxRows, flags);
+    victim->count = 0;
+    victim->lastUse = ++pool.tick;
+    victim->serial++;
+    return victim;
+}
+
+// Function to pick the slot the generator should fill next: the most recently requested one
+// that is not full, or NULL (pool lock held)
+static PoolSlot *neediestSlot() {
+    PoolSlot *best = NULL;
+    for (int s = 0; s < POOL_SETTINGS; s++) {
+        PoolSlot *slot = &pool.slots[s];
+        if (slot->n != 0 && slot->count < POOL_DEPTH && (best == NULL || slot->lastUse > best->lastUse))
+            best = slot;
+    }
+    return best;
+}
+
+// Thread function: generate puzzles, without holding the lock, until every slot in use is full, then wait
+static void *generatePuzzles(void *arg) {
+    (void) arg;
+    TRACE_THREAD("puzzle generator");
+    rng_seed(time(NULL) ^ 0x5DEECE66DULL);  // Own sequence, apart from the game's
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        PoolSlot *slot = neediestSlot();
+        if (slot == NULL) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+            continue;
+        }
+        const Geometry *g = slot->geom;
+        int hints = slot->hints;
+        unsigned long serial = slot->serial;
+        pthread_mutex_unlock(&pool.lock);
+
+        TRACE_BEGIN(generate);
+        int *cells = calloc(g->cells, sizeof(int));
+        int *fixedCells = malloc(g->cells * sizeof(int));
+        generateCells(g, cells);
+        removeCells(g->size, g->cells - hints, cells, fixedCells);
+        TRACE_END(generate, "pool puzzle");
+
+        pthread_mutex_lock(&pool.lock);
+        if (slot->serial == serial && slot->count < POOL_DEPTH) {
+            slot->cells[slot->count] = cells;
+            slot->fixedCells[slot->count++] = fixedCells;
+        } else {  // The setting was replaced or filled while we worked
+            free(cells);
+            free(fixedCells);
+        }
+    }
+    return NULL;
+}
+
+// Function to start the background generator (once; later calls do nothing)
+void pool_start() {
+    pthread_mutex_lock(&pool.lock);
+    if (!pool.started) {
+        pool.started = 1;
+        pthread_create(&pool.generator, NULL, generatePuzzles, NULL);
+        pthread_detach(pool.generator);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Function to ask for puzzles of a setting ahead of time, e.g. as soon as the player picks a size
+void pool_prefetch(int n, int boxRows, int flags, int hints) {
+    pthread_mutex_lock(&pool.lock);
+    findSlot(n, boxRows, flags, hints);
+    pthread_cond_signal(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Function to take a ready puzzle of a setting into cells and fixedCells (n * n each) without waiting.
+// Returns 0 if none is ready; the generator then starts on the setting, so the next request is served.
+int pool_take(int n, int boxRows, int flags, int hints, int *cells, int *fixedCells) {
+    pthread_mutex_lock(&pool.lock);
+    PoolSlot *slot = findSlot(n, boxRows, flags, hints);
+    int taken = slot->count > 0;
+    int *readyCells = NULL, *readyFixed = NULL;
+    if (taken) {
+        readyCells = slot->cells[0];
+        readyFixed = slot->fixedCells[0];
+        slot->count--;
+        memmove(slot->cells, slot->cells + 1, slot->count * sizeof(int *));
+        memmove(slot->fixedCells, slot->fixedCells + 1, slot->count * sizeof(int *));
+    }
+    pthread_cond_signal(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    if (taken) {
+        memcpy(cells, readyCells, n * n * sizeof(int));
+        memcpy(fixedCells, readyFixed, n * n * sizeof(int));
+        free(readyCells);
+        free(readyFixed);
+    }
+    return taken;
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sudoku.h"
+
+#define ENGINE_COUNT 4   // Backtracking, SA, GA and min-conflicts race on the same puzzle
+
+static const char *engineNames[ENGINE_COUNT] = {
+    "Backtracking", "Simulated Annealing", "Genetic Algorithm", "Min-Conflicts Tabu Search"
+};
+
+// One engine taking part in the race
+typedef struct {
+    int index;             // Engine number (position in engineNames)
+    int **board;           // Private copy of the puzzle, solved in place
+    int **puzzle;          // Original puzzle (shared, read only)
+    int **fixed;           // Fixed cells of the puzzle (shared, read only)
+    SolveLimits limits;    // Deadline of the portfolio and the shared cancel flag
+    atomic_int *cancel;    // Shared flag checked by every engine in its inner loop
+    atomic_int *winner;    // Index of the first engine with a valid solution, -1 while there is none
+    SolveResult result;
+} PortfolioEntry;
+
+// Function to check if a board is complete, conflict free and keeps all given cells
+static int isValidSolution(int **board, int **puzzle) {
+    GameState game;
+    game_init(&game, board, NULL);
+    int valid = game_finished(&game);
+    game_free(&game);
+
+    for (int i = 0; i < size && valid; i++)
+        for (int j = 0; j < size; j++)
+            if (puzzle[i][j] != 0 && puzzle[i][j] != board[i][j])
+                valid = 0;
+    return valid;
+}
+
+// Thread function: run one engine and claim the win if its board is a valid solution
+static void *raceEngine(void *arg) {
+    PortfolioEntry *entry = arg;
+    TRACE_THREAD(engineNames[entry->index]);
+    rng_seed(randomSeed * ENGINE_COUNT + entry->index);
+
+    switch (entry->index) {
+        case 0: entry->result = solveBacktrack(entry->board, &entry->limits); break;
+        case 1: entry->result = runSA(entry->board, &entry->limits); break;
+        case 2: entry->result = runGA(entry->board, entry->fixed, &entry->limits); break;
+        case 3: entry->result = runMC(entry->board, &entry->limits); break;
+    }
+
+    if (isValidSolution(entry->board, entry->puzzle)) {
+        int expected = -1;
+        if (atomic_compare_exchange_strong(entry->winner, &expected, entry->index))
+            atomic_store(entry->cancel, 1);  // Tell the other engines to stop
+    }
+    return NULL;
+}
+
+// Function to race all engines on the same puzzle; the first valid solution is copied to the board.
+// The deadline of the limits applies to every engine; iteration budgets are per engine and not shared.
+SolveResult runPortfolio(int **board, int **fixed, const SolveLimits *limits) {
+    double start = solver_clock();
+    atomic_int cancel = 0, winner = -1;
+    PortfolioEntry entries[ENGINE_COUNT];
+    pthread_t threads[ENGINE_COUNT];
+    geometry_current();  // Build the lookup tables before the engines share them
+
+    for (int e = 0; e < ENGINE_COUNT; e++) {
+        entries[e].index = e;
+        entries[e].board = allocate_board();
+        for (int i = 0; i < size; i++)
+            memcpy(entries[e].board[i], board[i], size * sizeof(int));
+        entries[e].puzzle = board;
+        entries[e].fixed = fixed;
+        entries[e].limits.deadline = limits != NULL ? limits->deadline : 0;
+        entries[e].limits.max_iterations = limits != NULL ? limits->max_iterations : 0;
+        entries[e].limits.cancel = &cancel;
+        entries[e].cancel = &cancel;
+        entries[e].winner = &winner;
+        pthread_create(&threads[e], NULL, raceEngine, &entries[e]);
+    }
+    for (int e = 0; e < ENGINE_COUNT; e++)
+        pthread_join(threads[e], NULL);
+
+    int w = atomic_load(&winner);
+    printf("\n===== PORTFOLIO RESULT =====\n");
+    for (int e = 0; e < ENGINE_COUNT; e++)
+        printf("%-26s %-26s %8.3f s%s\n", engineNames[e], solve_status_name(entries[e].result.status),
+               entries[e].result.elapsed, e == w ? "  <== winner" : "");
+
+    // Report the winner, or the engine that got closest when nobody solved the puzzle
+    int reported = w;
+    if (w >= 0) {
+        for (int i = 0; i < size; i++)
+            memcpy(board[i], entries[w].board[i], size * sizeof(int));
+    } else {
+        reported = 1;
+        for (int e = 0; e < ENGINE_COUNT; e++)
+            if (entries[e].result.energy < entries[reported].result.energy) reported = e;
+    }
+    SolveResult result = entries[reported].result;
+    if (w < 0 && result.status == SOLVE_SOLVED)
+        result.status = SOLVE_UNSOLVED;  // Its board did not pass the validity check
+    result.elapsed = solver_clock() - start;
+
+    for (int e = 0; e < ENGINE_COUNT; e++)
+        free_board(entries[e].board);
+    return result;
+}
@@ -0,0 +1,170 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sudoku.h"
+
+#define RENDER_EMPTY '.'
+#define RENDER_CLEAR "\033[H\033[2J"         // Cursor home and clear the screen
+#define RENDER_CURSOR_BYTES 11              // "\033[rrr;cccH": longest cursor move to a cell of a 64x64 board
+
+int redrawChanged = 0;  // The interactive game redraws only the cells that changed (--redraw changed)
+
+// One character per value, so boards up to 64x64 keep their columns aligned
+static const char glyphs[MAX_SIZE + 1] = "123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz@#$%";
+
+static BoardRenderer console;  // Renderer of displayBoard, set up on its first call
+
+// Function to get the character shown for a value: 1-9, then A-Z and a-z, '.' for an empty cell
+char render_glyph(int value) {
+    return value >= 1 && value <= MAX_SIZE ? glyphs[value - 1] : RENDER_EMPTY;
+}
+
+// Function to set up a renderer writing to a file descriptor. Redrawing only the changed cells needs a
+// terminal, so it is turned off when fd is not one (a log gets full frames).
+void render_init(BoardRenderer *r, int fd, int changedOnly) {
+    r->fd = fd;
+    r->changedOnly = changedOnly && isatty(fd);
+    r->n = 0;
+    r->boxRows = 0;
+    r->shown = NULL;
+    r->buffer = NULL;
+    r->capacity = 0;
+}
+
+void render_free(BoardRenderer *r) {
+    free(r->shown);
+    free(r->buffer);
+    r->shown = NULL;
+    r->buffer = NULL;
+    r->capacity = 0;
+    r->n = 0;
+}
+
+// Function to make the next frame a full one, e.g. after other output scrolled the board away
+void render_invalidate(BoardRenderer *r) {
+    r->n = 0;
+}
+
+// Function to append a number in decimal
+static char *putNumber(char *p, int value) {
+    char digits[12];
+    int len = 0;
+    do {
+        digits[len++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (len > 0) *p++ = digits[--len];
+    return p;
+}
+
+// Function to append the ANSI cursor move to a screen position (both 1-based)
+static char *putCursor(char *p, int line, int column) {
+    *p++ = '\033';
+    *p++ = '[';
+    p = putNumber(p, line);
+    *p++ = ';';
+    p = putNumber(p, column);
+    *p++ = 'H';
+    return p;
+}
+
+// Function to size the buffers for a board shape; the buffer holds a full frame or a frame where every cell changed
+static void resize(BoardRenderer *r, int n, int boxRows) {
+    int lines = n + n / boxRows - 1;
+    int width = 2 * n + 2 * (boxRows - 1) - 1;
+    size_t full = sizeof(RENDER_CLEAR) + (size_t) lines * (width + 1);
+    size_t changed = (size_t) n * n * (RENDER_CURSOR_BYTES + 1) + 2 * RENDER_CURSOR_BYTES;
+    r->capacity = full > changed ? full : changed;
+    r->buffer = realloc(r->buffer, r->capacity);
+    r->shown = realloc(r->shown, (size_t) n * n * sizeof(int));
+}
+
+// Function to format the whole board: digits as glyphs, '|' between blocks and dashes between block rows
+static char *putFullFrame(BoardRenderer *r, char *p, int **board) {
+    int n = r->n, boxRows = r->boxRows, boxCols = n / boxRows;
+    int width = 2 * n + 2 * (boxRows - 1) - 1;
+    for (int i = 0; i < n; i++) {
+        if (i % boxRows == 0 && i != 0) {
+            for (int k = 0; k < width; k++) *p++ = '-';  // Row separator
+            *p++ = '\n';
+        }
+        for (int j = 0; j < n; j++) {
+            if (j % boxCols == 0 && j != 0) {
+                *p++ = '|';  // Column separator
+                *p++ = ' ';
+            }
+            *p++ = render_glyph(board[i][j]);
+            *p++ = j + 1 < n ? ' ' : '\n';
+            r->shown[i * n + j] = board[i][j];
+        }
+    }
+    return p;
+}
+
+// Function to format only the cells that differ from the screen, each after a cursor move to its position,
+// and leave the cursor on the line below the board with the rest of the screen cleared
+static char *putChangedCells(BoardRenderer *r, char *p, int **board) {
+    int n = r->n, boxRows = r->boxRows, boxCols = n / boxRows;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (r->shown[i * n + j] == board[i][j])
+                continue;
+            p = putCursor(p, 1 + i + i / boxRows, 1 + 2 * j + 2 * (j / boxCols));
+            *p++ = render_glyph(board[i][j]);
+            r->shown[i * n + j] = board[i][j];
+        }
+    }
+    p = putCursor(p, n + n / boxRows, 1);
+    *p++ = '\033';
+    *p++ = '[';
+    *p++ = 'J';
+    return p;
+}
+
+// Function to format the next frame of a board of the current size into the renderer's buffer and return its length.
+// The first frame (and any frame after a size change or render_invalidate) is the full board; with changedOnly
+// the later ones only hold the cells that changed.
+size_t render_frame(BoardRenderer *r, int **board) {
+    char *p;
+    if (r->n != size || r->boxRows != sub || !r->changedOnly) {
+        if (r->n != size || r->boxRows != sub)
+            resize(r, size, sub);
+        r->n = size;
+        r->boxRows = sub;
+        p = r->buffer;
+        if (r->changedOnly)  // The board starts at the top of the screen, where the cursor moves expect it
+            for (const char *c = RENDER_CLEAR; *c; c++) *p++ = *c;
+        p = putFullFrame(r, p, board);
+    } else {
+        p = putChangedCells(r, r->buffer, board);
+    }
+    return p - r->buffer;
+}
+
+// Function to draw the next frame of a board with a single write
+void render_board(BoardRenderer *r, int **board) {
+    size_t len = render_frame(r, board), done = 0;
+    if (r->fd == STDOUT_FILENO)
+        fflush(stdout);  // Text printed before the board has to come first
+    while (done < len) {
+        ssize_t written = write(r->fd, r->buffer + done, len - done);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            break;
+        done += written;
+    }
+}
+
+// Function to display the current state of the board on standard output
+void displayBoard(int **board) {
+    if (console.buffer == NULL)
+        render_init(&console, STDOUT_FILENO, redrawChanged);
+    render_board(&console, board);
+}
+
+// Function to make the next displayBoard draw the whole board again (after menus and other output)
+void displayReset() {
+    render_invalidate(&console);
+}
@@ -0,0 +1,33 @@
+#include "sudoku.h"
+
+unsigned long long randomSeed = 0;  // Seed of the run: the clock, or --seed (set in main)
+
+// Generator state of the calling thread (xorshift64*), so solvers running in parallel never share it
+static _Thread_local unsigned long long rngState = 0x9E3779B97F4A7C15ULL;
+
+// Function to seed the random number generator of the calling thread
+void rng_seed(unsigned long long seed) {
+    // SplitMix64 step spreads nearby seeds (e.g. consecutive thread numbers) over the whole state
+    unsigned long long z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    rngState = (z ^ (z >> 31)) | 1;  // The state must never be zero
+}
+
+// Function to get the next random number in 0..RNG_MAX
+int rng_next() {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return (int) ((rngState * 0x2545F4914F6CDD1DULL) >> 33);
+}
+
+// Function to get the generator state of the calling thread, e.g. for a checkpoint
+unsigned long long rng_state() {
+    return rngState;
+}
+
+// Function to continue from a state returned by rng_state
+void rng_restore(unsigned long long state) {
+    rngState = state ? state : 0x9E3779B97F4A7C15ULL;
+}
@@ -3,161 +3,386 @@
 #include <math.h>
 #include <time.h>
 #include <string.h>
+#include "sudoku.h"
 
-#define SIZE 9
-#define SUB 3
-#define INF 1000000
-
-typedef struct {
-    int grid[SIZE][SIZE];
-    int fixed[SIZE][SIZE];
-    int energy;
-} SudokuState;
-
-// Calculates the energy (number of conflicts in rows and columns)
-int calculate_energy(SudokuState *state) {
-    int energy = 0;
-
-    // Row conflicts
-    for (int i = 0; i < SIZE; i++) {
-        int count[SIZE + 1] = {0};
-        for (int j = 0; j < SIZE; j++) count[state->grid[i][j]]++;
-        for (int k = 1; k <= SIZE; k++) if (count[k] > 1) energy += count[k] - 1;
+#define SA_EPOCH_MOVES 100    // Moves per annealing epoch in the trace (temperature drops ~63%)
+#define SA_MAX_MOVES 2000000  // Default budget of moves when the run has no deadline
+
+// Counts the pair cells (anti-knight) of a cell that hold the value v
+static int pair_count(const Geometry *g, const cell_t *grid, int cell, int v) {
+    int same = 0;
+    for (int k = g->pairStart[cell]; k < g->pairStart[cell + 1]; k++)
+        same += v && grid[g->pairs[k]] == v;
+    return same;
+}
+
+// Recounts the digits of a grid into counts that are already allocated.
+// On variant boards every pair of cells holding the same digit is one more conflict.
+void unit_counts_load(UnitCounts *uc, const cell_t *grid) {
+    const Geometry *g = uc->geom;
+    memset(uc->count, 0, g->units * (g->size + 1));
+    uc->conflicts = 0;
+    for (int u = 0; u < g->units; u++) {
+        unsigned char *count = &uc->count[u * (g->size + 1)];
+        for (int k = 0; k < g->size; k++) {
+            int v = grid[g->unitCells[u * g->size + k]];
+            if (v && count[v]++ > 0) uc->conflicts++;  // Every repetition of a digit is one conflict
+        }
+    }
+    if (g->variant) {
+        int same = 0;
+        for (int cell = 0; cell < g->cells; cell++)
+            same += pair_count(g, grid, cell, grid[cell]);
+        uc->conflicts += same / 2;  // Seen from both cells
     }
+}
+
+// Allocates the digit counts of every unit and fills them from a grid
+void unit_counts_init(UnitCounts *uc, const Geometry *g, const cell_t *grid) {
+    uc->geom = g;
+    uc->count = malloc(g->units * (g->size + 1) * sizeof(unsigned char));
+    unit_counts_load(uc, grid);
+}
 
-    // Column conflicts
-    for (int j = 0; j < SIZE; j++) {
-        int count[SIZE + 1] = {0};
-        for (int i = 0; i < SIZE; i++) count[state->grid[i][j]]++;
-        for (int k = 1; k <= SIZE; k++) if (count[k] > 1) energy += count[k] - 1;
+// Frees the digit counts
+void unit_counts_free(UnitCounts *uc) {
+    free(uc->count);
+    uc->count = NULL;
+}
+
+// Returns 1 if the unit is one of the units of the cell
+static int cell_in_unit(const Geometry *g, int cell, int unit) {
+    const int *units = &g->cellUnits[cell * UNITS_PER_CELL];
+    if (units[0] == unit || units[1] == unit || units[2] == unit)
+        return 1;
+    if (g->variant)
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++)
+            if (g->extraUnits[k] == unit) return 1;
+    return 0;
+}
+
+// Change of the conflicts of a swap in the extra units and pairs of a variant board
+static int variant_swap_delta(const UnitCounts *uc, const cell_t *grid, int a, int b) {
+    const Geometry *g = uc->geom;
+    int delta = 0;
+    for (int side = 0; side < 2; side++) {
+        int cell = side ? b : a, other = side ? a : b;
+        int out = grid[cell], in = grid[other];
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++) {
+            int u = g->extraUnits[k];
+            if (cell_in_unit(g, other, u)) continue;
+            const unsigned char *count = &uc->count[u * (g->size + 1)];
+            if (count[out] > 1) delta--;
+            if (count[in] > 0) delta++;
+        }
+        for (int k = g->pairStart[cell]; k < g->pairStart[cell + 1]; k++) {
+            int p = g->pairs[k];
+            if (p == other) continue;  // The two cells trade different values: no conflict between them
+            if (out && grid[p] == out) delta--;
+            if (in && grid[p] == in) delta++;
+        }
     }
+    return delta;
+}
 
-    return energy;
+// Calculates in O(1) how the number of conflicts changes if two cells swap their values
+int unit_counts_swap_delta(const UnitCounts *uc, const cell_t *grid, int a, int b) {
+    const Geometry *g = uc->geom;
+    int va = grid[a], vb = grid[b];
+    if (va == vb) return 0;
+
+    int delta = 0;
+    for (int side = 0; side < 2; side++) {
+        int cell = side ? b : a, other = side ? a : b;
+        int out = side ? vb : va, in = side ? va : vb;  // Value leaving and entering the cell
+        for (int t = 0; t < UNITS_PER_CELL; t++) {
+            int u = g->cellUnits[cell * UNITS_PER_CELL + t];
+            if (cell_in_unit(g, other, u)) continue;  // Units holding both cells keep their digits
+            const unsigned char *count = &uc->count[u * (g->size + 1)];
+            if (count[out] > 1) delta--;
+            if (count[in] > 0) delta++;
+        }
+    }
+    if (g->variant)
+        delta += variant_swap_delta(uc, grid, a, b);
+    return delta;
 }
 
-// Initializes the Sudoku board by filling missing values randomly within each block
-void initialize_state(SudokuState *state) {
-    for (int bi = 0; bi < SIZE; bi += SUB) {
-        for (int bj = 0; bj < SIZE; bj += SUB) {
-            int present[SIZE + 1] = {0};
-            int idx = 0;
-            int missing[SIZE];
-
-            // Track existing values
-            for (int i = 0; i < SUB; i++) {
-                for (int j = 0; j < SUB; j++) {
-                    int val = state->grid[bi + i][bj + j];
-                    if (val) present[val] = 1;
-                }
-            }
+// Calculates in O(1) how the number of conflicts changes if a cell takes another value
+int unit_counts_set_delta(const UnitCounts *uc, const cell_t *grid, int cell, int val) {
+    const Geometry *g = uc->geom;
+    int old = grid[cell];
+    if (old == val) return 0;
 
-            // Collect missing values
-            for (int k = 1; k <= SIZE; k++) {
-                if (!present[k]) missing[idx++] = k;
-            }
+    int delta = 0;
+    for (int t = 0; t < UNITS_PER_CELL; t++) {
+        const unsigned char *count = &uc->count[g->cellUnits[cell * UNITS_PER_CELL + t] * (g->size + 1)];
+        if (old && count[old] > 1) delta--;
+        if (val && count[val] > 0) delta++;
+    }
+    if (g->variant) {
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++) {
+            const unsigned char *count = &uc->count[g->extraUnits[k] * (g->size + 1)];
+            if (old && count[old] > 1) delta--;
+            if (val && count[val] > 0) delta++;
+        }
+        delta += pair_count(g, grid, cell, val) - pair_count(g, grid, cell, old);
+    }
+    return delta;
+}
 
-            // Shuffle missing values
-            for (int i = idx - 1; i > 0; i--) {
-                int j = rand() % (i + 1);
-                int temp = missing[i];
-                missing[i] = missing[j];
-                missing[j] = temp;
-            }
+// Changes the value of one cell and updates the counts
+void unit_counts_set(UnitCounts *uc, cell_t *grid, int cell, int val) {
+    const Geometry *g = uc->geom;
+    int old = grid[cell];
+    if (old == val) return;
 
-            // Fill empty cells with shuffled values
-            idx = 0;
-            for (int i = 0; i < SUB; i++) {
-                for (int j = 0; j < SUB; j++) {
-                    if (state->grid[bi + i][bj + j] == 0) {
-                        state->grid[bi + i][bj + j] = missing[idx++];
-                    }
-                }
-            }
+    for (int t = 0; t < UNITS_PER_CELL; t++) {
+        unsigned char *count = &uc->count[g->cellUnits[cell * UNITS_PER_CELL + t] * (g->size + 1)];
+        if (old && --count[old] > 0) uc->conflicts--;
+        if (val && count[val]++ > 0) uc->conflicts++;
+    }
+    if (g->variant) {
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++) {
+            unsigned char *count = &uc->count[g->extraUnits[k] * (g->size + 1)];
+            if (old && --count[old] > 0) uc->conflicts--;
+            if (val && count[val]++ > 0) uc->conflicts++;
         }
+        uc->conflicts += pair_count(g, grid, cell, val) - pair_count(g, grid, cell, old);
     }
+    grid[cell] = val;
+}
 
-    state->energy = calculate_energy(state);
+// Swaps the values of two cells and updates the counts
+void unit_counts_swap(UnitCounts *uc, cell_t *grid, int a, int b) {
+    int va = grid[a], vb = grid[b];
+    unit_counts_set(uc, grid, a, vb);
+    unit_counts_set(uc, grid, b, va);
 }
 
-// Generates a neighbor state by swapping two unfixed cells in a random block
-void generate_neighbor(SudokuState *current_state, SudokuState *neighbor_state) {
-    memcpy(neighbor_state, current_state, sizeof(SudokuState));
+// Counts the units in which the value of a cell is repeated
+int unit_counts_cell_conflicts(const UnitCounts *uc, const cell_t *grid, int cell) {
+    const Geometry *g = uc->geom;
+    int v = grid[cell], conflicts = 0;
+    if (!v) return 0;
+    for (int t = 0; t < UNITS_PER_CELL; t++)
+        if (uc->count[g->cellUnits[cell * UNITS_PER_CELL + t] * (g->size + 1) + v] > 1) conflicts++;
+    if (g->variant) {
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++)
+            if (uc->count[g->extraUnits[k] * (g->size + 1) + v] > 1) conflicts++;
+        conflicts += pair_count(g, grid, cell, v);
+    }
+    return conflicts;
+}
 
-    int bi = (rand() % SUB) * SUB;
-    int bj = (rand() % SUB) * SUB;
+// Allocates the arrays of a state for the current board size
+void alloc_state(SudokuState *state) {
+    state->geom = geometry_current();
+    state->grid = calloc(size * size, sizeof(cell_t));
+    state->fixed = calloc(size * size, sizeof(unsigned char));
+    state->movable = malloc(size * size * sizeof(int));
+    state->movable_count = calloc(size, sizeof(int));
+    state->counts.count = NULL;
+    state->energy = 0;
+}
 
-    int cells[SIZE][2];
-    int count = 0;
+// Frees the arrays of a state
+void free_state(SudokuState *state) {
+    free(state->grid);
+    free(state->fixed);
+    free(state->movable);
+    free(state->movable_count);
+    unit_counts_free(&state->counts);
+}
 
-    for (int i = 0; i < SUB; i++) {
-        for (int j = 0; j < SUB; j++) {
-            int r = bi + i;
-            int c = bj + j;
-            if (!neighbor_state->fixed[r][c]) {
-                cells[count][0] = r;
-                cells[count][1] = c;
-                count++;
-            }
+// Copies the values and energy of one state into another
+void copy_state(SudokuState *dst, const SudokuState *src) {
+    memcpy(dst->grid, src->grid, size * size * sizeof(cell_t));
+    dst->energy = src->energy;
+}
+
+// Loads a puzzle into a state: non-zero cells become fixed
+void load_state(SudokuState *state, int **board) {
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            state->grid[i * size + j] = board[i][j];
+            state->fixed[i * size + j] = (board[i][j] != 0);
         }
     }
+}
+
+// Initializes the Sudoku board by filling missing values randomly within each block,
+// lists the unfixed cells of every block and counts the conflicts.
+// Blocks stay permutations of 1..size, so only rows and columns can conflict afterwards.
+void initialize_state(SudokuState *state) {
+    const Geometry *g = state->geom;
 
-    if (count >= 2) {
-        int a = rand() % count;
-        int b = rand() % count;
-        while (b == a) b = rand() % count;
+    for (int b = 0; b < size; b++) {
+        const int *cells = &g->unitCells[(2 * size + b) * size];
+        DigitSet present = 0;
+        int idx = 0;
+        cell_t missing[MAX_SIZE];
 
-        int r1 = cells[a][0], c1 = cells[a][1];
-        int r2 = cells[b][0], c2 = cells[b][1];
+        // Track existing values and unfixed cells
+        state->movable_count[b] = 0;
+        for (int k = 0; k < size; k++) {
+            int val = state->grid[cells[k]];
+            if (val) present |= DIGIT_BIT(val);
+            if (!state->fixed[cells[k]]) state->movable[b * size + state->movable_count[b]++] = cells[k];
+        }
+
+        // Collect missing values
+        for (int k = 1; k <= size; k++) {
+            if (!(present & DIGIT_BIT(k))) missing[idx++] = k;
+        }
+
+        // Shuffle missing values
+        for (int i = idx - 1; i > 0; i--) {
+            int j = rng_next() % (i + 1);
+            cell_t temp = missing[i];
+            missing[i] = missing[j];
+            missing[j] = temp;
+        }
 
-        int tmp = neighbor_state->grid[r1][c1];
-        neighbor_state->grid[r1][c1] = neighbor_state->grid[r2][c2];
-        neighbor_state->grid[r2][c2] = tmp;
+        // Fill empty cells with shuffled values
+        idx = 0;
+        for (int k = 0; k < size; k++) {
+            if (state->grid[cells[k]] == 0) {
+                state->grid[cells[k]] = missing[idx++];
+            }
+        }
     }
 
-    neighbor_state->energy = calculate_energy(neighbor_state);
+    unit_counts_free(&state->counts);
+    unit_counts_init(&state->counts, g, state->grid);
+    state->energy = state->counts.conflicts;
+}
+
+// Picks two unfixed cells of a random block to swap; returns 0 if the block has fewer than two
+int generate_neighbor(const SudokuState *state, int *first, int *second) {
+    int b = rng_next() % size;
+    int count = state->movable_count[b];
+    if (count < 2) return 0;
+
+    int a = rng_next() % count;
+    int c = rng_next() % count;
+    while (c == a) c = rng_next() % count;
+
+    *first = state->movable[b * size + a];
+    *second = state->movable[b * size + c];
+    return 1;
+}
+
+// Bytes of an SA checkpoint: generator state, temperature, moves, best energy, current and best grid
+#define SA_CHECKPOINT_BYTES (3 * 8 + sizeof(int) + 2 * size * size * sizeof(cell_t))
+
+// Function to snapshot an annealing run for --checkpoint
+static void saveSA(Checkpoint *checkpoint, double T, long long moves, const SudokuState *current,
+                   const SudokuState *best) {
+    unsigned long long rng = rng_state();
+    checkpoint_begin(checkpoint);
+    checkpoint_put(checkpoint, &rng, sizeof(rng));
+    checkpoint_put(checkpoint, &T, sizeof(T));
+    checkpoint_put(checkpoint, &moves, sizeof(moves));
+    checkpoint_put(checkpoint, &best->energy, sizeof(best->energy));
+    checkpoint_put(checkpoint, current->grid, size * size * sizeof(cell_t));
+    checkpoint_put(checkpoint, best->grid, size * size * sizeof(cell_t));
+    checkpoint_commit(checkpoint);
+}
+
+// Function to continue an annealing run from its checkpoint
+static void resumeSA(Checkpoint *checkpoint, double *T, long long *moves, SudokuState *current, SudokuState *best) {
+    unsigned long long rng;
+    checkpoint_read(checkpoint, &rng, sizeof(rng));
+    checkpoint_read(checkpoint, T, sizeof(*T));
+    checkpoint_read(checkpoint, moves, sizeof(*moves));
+    checkpoint_read(checkpoint, &best->energy, sizeof(best->energy));
+    checkpoint_read(checkpoint, current->grid, size * size * sizeof(cell_t));
+    checkpoint_read(checkpoint, best->grid, size * size * sizeof(cell_t));
+    rng_restore(rng);
+    unit_counts_load(&current->counts, current->grid);
+    current->energy = current->counts.conflicts;
 }
 
 // Simulated Annealing algorithm to solve Sudoku
-void runSA(int **board) {
-    SudokuState current_state;
-    memset(&current_state, 0, sizeof(SudokuState));
+SolveResult runSA(int **board, const SolveLimits *limits) {
+    PERF_BEGIN(runPerf);
+    SolveProgress progress;
+    solve_begin(&progress, limits, limits != NULL && limits->deadline > 0 ? 0 : SA_MAX_MOVES);
+    SolveStatus status = SOLVE_RUNNING;
 
-    for (int i = 0; i < SIZE; i++) {
-        for (int j = 0; j < SIZE; j++) {
-            current_state.grid[i][j] = board[i][j];
-            current_state.fixed[i][j] = (board[i][j] != 0);
-        }
-    }
+    SudokuState current_state;
+    alloc_state(&current_state);
+    load_state(&current_state, board);
+    int resumed;
+    Checkpoint *checkpoint = checkpoint_open(CHECKPOINT_SA, current_state.grid, current_state.fixed,
+                                             SA_CHECKPOINT_BYTES, &resumed);
 
+    TRACE_BEGIN(setup);
     initialize_state(&current_state);
+    TRACE_END(setup, "SA setup");
+    metrics_phase(PHASE_SETUP, solver_clock() - progress.start);
 
-    // SA parameters
-    double T_start = 1000.0;
+    // SA parameters: one cooling schedule takes about 1150 moves
+    const double T_hot = 1000.0;
+    double T_start = T_hot;
     double T_end = 0.01;
     double alpha = 0.99;
 
     SudokuState best_state;
-    memcpy(&best_state, &current_state, sizeof(SudokuState));
+    alloc_state(&best_state);
+    copy_state(&best_state, &current_state);
+    if (resumed)
+        resumeSA(checkpoint, &T_start, &progress.iterations, &current_state, &best_state);
 
-    while (T_start > T_end && best_state.energy > 0) {
-        SudokuState neighbor_state;
-        generate_neighbor(&current_state, &neighbor_state);
-        neighbor_state.energy = calculate_energy(&neighbor_state);
+    TRACE_BEGIN(epoch);
+    while (best_state.energy > 0) {
+        if ((status = solve_check(&progress)) != SOLVE_RUNNING)
+            break;  // Deadline, budget or cancellation
+        if (T_start <= T_end) {
+            // Frozen without a solution: reheat and anneal again from the best board, until the limits stop the run
+            copy_state(&current_state, &best_state);
+            unit_counts_load(&current_state.counts, current_state.grid);
+            T_start = T_hot;
+        }
+        if (progress.iterations % SA_EPOCH_MOVES == 0 && progress.iterations > 0) {
+            TRACE_END(epoch, "SA epoch");
+            if (checkpoint_due(checkpoint))
+                saveSA(checkpoint, T_start, progress.iterations, &current_state, &best_state);
+            TRACE_RESTART(epoch);
+        }
+        progress.iterations++;
 
-        int delta_energy = neighbor_state.energy - current_state.energy;
+        int a, b;
+        if (generate_neighbor(&current_state, &a, &b)) {
+            int delta_energy = unit_counts_swap_delta(&current_state.counts, current_state.grid, a, b);
 
-        if (delta_energy < 0 || (rand() / (double)RAND_MAX) < exp(-delta_energy / T_start)) {
-            memcpy(&current_state, &neighbor_state, sizeof(SudokuState));
-            if (current_state.energy < best_state.energy) {
-                memcpy(&best_state, &current_state, sizeof(SudokuState));
+            if (delta_energy < 0 || (rng_next() / (double)RNG_MAX) < exp(-delta_energy / T_start)) {
+                unit_counts_swap(&current_state.counts, current_state.grid, a, b);
+                current_state.energy += delta_energy;
+                if (current_state.energy < best_state.energy) {
+                    copy_state(&best_state, &current_state);
+                }
+                metrics_add(METRIC_SA_ACCEPTED, 1);
+            } else {
+                metrics_add(METRIC_SA_REJECTED, 1);
             }
         }
 
         T_start *= alpha;
     }
+    TRACE_END(epoch, "SA epoch");
+    if (checkpoint != NULL && status != SOLVE_RUNNING)  // Stopped by a limit: keep the state for a later run
+        saveSA(checkpoint, T_start, progress.iterations, &current_state, &best_state);
+    checkpoint_close(checkpoint, status == SOLVE_RUNNING);
+
+    for (int i = 0; i < size; i++)
+        for (int j = 0; j < size; j++)
+            board[i][j] = best_state.grid[i * size + j];
 
-    printf("Solved energy: %d\n", best_state.energy);
-    for (int i = 0; i < SIZE; i++)
-        for (int j = 0; j < SIZE; j++)
-            board[i][j] = best_state.grid[i][j];
+    SolveResult result = solve_finish(&progress, status, best_state.energy);
+    free_state(&current_state);
+    free_state(&best_state);
+    PERF_END(runPerf, PERF_SA, 1);
+    return result;
 }
@@ -0,0 +1,620 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sudoku.h"
+
+#define SAT_RESTART_BASE 100        // Conflicts of the first restart interval; later ones follow the Luby sequence
+#define SAT_REDUCE_FIRST 2000       // Conflicts before the first learnt clause cleanup
+#define SAT_REDUCE_STEP 300         // Each cleanup comes this many conflicts later than the previous one
+#define SAT_VAR_DECAY 0.95          // VSIDS: activities of old conflicts fade by this factor per conflict
+#define SAT_GLUE_KEEP 2             // Learnt clauses spanning at most this many levels are never removed
+
+#define REASON_NONE (-1)            // Decision or given: no reason
+#define CLAUSE_LEARNT 1             // Flag in the second header word of a clause, below the LBD
+#define CLAUSE_MOVED (-1)           // Size word of a clause copied by collectGarbage; the flags word holds the new reference
+
+// Literals: 2 * var for "var is true", 2 * var + 1 for "var is false". Variable cell * n + v - 1 means
+// that the cell holds v. A clause is a reference into the arena: its size, its flags and LBD, then its
+// literals, the two watched ones first.
+#define LIT(var, negative) (2 * (var) + (negative))
+#define LIT_VAR(lit) ((lit) >> 1)
+#define LIT_NEG(lit) ((lit) & 1)
+
+// Watch of a clause: visited when the literal it is filed under becomes true, i.e. the watched literal becomes false
+typedef struct {
+    int clause;
+    int blocker;    // Some other literal of the clause; if it is true the clause need not be looked at
+} Watch;
+
+typedef struct {
+    Watch *items;
+    int count, cap;
+} WatchList;
+
+typedef struct {
+    const Geometry *geom;
+    int n, vars;
+
+    signed char *assign;    // Value of every variable: 1 true, 0 false, -1 not assigned
+    int *level;             // Decision level at which a variable was assigned
+    int *reason;            // Clause that implied it, REASON_NONE, or -2 - lit for the implicit binary clause (implied or lit)
+    int *trail, trailSize, qhead;
+    int *trailLimit, levels;  // Start of every decision level in the trail
+
+    int *arena;             // Clauses
+    size_t arenaSize, arenaCap;
+    int *problem, problemCount;   // Clauses of the encoding
+    int *learnts, learntCount, learntCap;
+    WatchList *watches;     // Indexed by literal
+
+    double *activity, varInc;
+    int *heap, heapSize, *heapIndex;   // Unassigned variables by activity (max-heap); heapIndex -1 if absent
+    unsigned char *phase;   // Saved polarity: the value a variable had when it was last unassigned
+    unsigned char *seen;
+    int *stamp, stampNow;   // For counting the distinct levels of a learnt clause
+    int *learnt;
+
+    long long conflicts, decisions, propagations;
+    int restarts, reductions;
+} Sat;
+
+// Function to get the value of a literal: 1 true, 0 false, -1 not assigned
+static inline int litValue(const Sat *s, int lit) {
+    int a = s->assign[LIT_VAR(lit)];
+    return a < 0 ? -1 : a ^ LIT_NEG(lit);
+}
+
+// --- Decision heap ---
+
+static void heapUp(Sat *s, int pos) {
+    int var = s->heap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (s->activity[s->heap[parent]] >= s->activity[var]) break;
+        s->heap[pos] = s->heap[parent];
+        s->heapIndex[s->heap[pos]] = pos;
+        pos = parent;
+    }
+    s->heap[pos] = var;
+    s->heapIndex[var] = pos;
+}
+
+static void heapDown(Sat *s, int pos) {
+    int var = s->heap[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= s->heapSize) break;
+        if (child + 1 < s->heapSize && s->activity[s->heap[child + 1]] > s->activity[s->heap[child]]) child++;
+        if (s->activity[s->heap[child]] <= s->activity[var]) break;
+        s->heap[pos] = s->heap[child];
+        s->heapIndex[s->heap[pos]] = pos;
+        pos = child;
+    }
+    s->heap[pos] = var;
+    s->heapIndex[var] = pos;
+}
+
+static void heapInsert(Sat *s, int var) {
+    if (s->heapIndex[var] >= 0) return;
+    s->heap[s->heapSize] = var;
+    heapUp(s, s->heapSize++);
+}
+
+static int heapPop(Sat *s) {
+    int var = s->heap[0];
+    s->heapIndex[var] = -1;
+    if (--s->heapSize > 0) {
+        s->heap[0] = s->heap[s->heapSize];
+        heapDown(s, 0);
+    }
+    return var;
+}
+
+// Function to raise the activity of a variable seen in a conflict (VSIDS)
+static void bumpVar(Sat *s, int var) {
+    if ((s->activity[var] += s->varInc) > 1e100) {  // Rescale everything before it overflows
+        for (int v = 0; v < s->vars; v++) s->activity[v] *= 1e-100;
+        s->varInc *= 1e-100;
+    }
+    if (s->heapIndex[var] >= 0) heapUp(s, s->heapIndex[var]);
+}
+
+// --- Assignment ---
+
+static void enqueue(Sat *s, int lit, int reason) {
+    int var = LIT_VAR(lit);
+    s->assign[var] = !LIT_NEG(lit);
+    s->level[var] = s->levels;
+    s->reason[var] = reason;
+    s->trail[s->trailSize++] = lit;
+}
+
+// Function to undo every assignment above a decision level, saving the phases
+static void cancelUntil(Sat *s, int level) {
+    if (s->levels <= level) return;
+    for (int i = s->trailSize - 1; i >= s->trailLimit[level]; i--) {
+        int var = LIT_VAR(s->trail[i]);
+        s->phase[var] = s->assign[var];
+        s->assign[var] = -1;
+        heapInsert(s, var);
+    }
+    s->trailSize = s->qhead = s->trailLimit[level];
+    s->levels = level;
+}
+
+// --- Clauses ---
+
+static void watchAdd(WatchList *list, int clause, int blocker) {
+    if (list->count == list->cap) {
+        list->cap = list->cap ? 2 * list->cap : 4;
+        list->items = realloc(list->items, list->cap * sizeof(Watch));
+    }
+    list->items[list->count].clause = clause;
+    list->items[list->count++].blocker = blocker;
+}
+
+static void attachClause(Sat *s, int clause) {
+    const int *lits = &s->arena[clause + 2];
+    watchAdd(&s->watches[lits[0] ^ 1], clause, lits[1]);
+    watchAdd(&s->watches[lits[1] ^ 1], clause, lits[0]);
+}
+
+// Function to store a clause of at least two literals in the arena and watch its first two
+static int addClause(Sat *s, const int *lits, int count, int learnt, int lbd) {
+    if (s->arenaSize + count + 2 > s->arenaCap) {
+        s->arenaCap = 2 * (s->arenaSize + count + 2);
+        s->arena = realloc(s->arena, s->arenaCap * sizeof(int));
+    }
+    int clause = (int) s->arenaSize;
+    s->arena[clause] = count;
+    s->arena[clause + 1] = (lbd << 2) | (learnt ? CLAUSE_LEARNT : 0);
+    memcpy(&s->arena[clause + 2], lits, count * sizeof(int));
+    s->arenaSize += count + 2;
+    attachClause(s, clause);
+    return clause;
+}
+
+// Function to get the literals of a reason: the implied literal first, then the false ones that implied it.
+// Implicit binary clauses are written to buffer.
+static const int *reasonLits(const Sat *s, int reason, int implied, int *buffer, int *count) {
+    if (reason >= 0) {
+        *count = s->arena[reason];
+        return &s->arena[reason + 2];
+    }
+    buffer[0] = implied;
+    buffer[1] = -2 - reason;
+    *count = 2;
+    return buffer;
+}
+
+// Function to propagate every assignment on the trail. The binary clauses of the encoding (one digit per
+// cell, no digit twice in a unit or pair) are implicit: placing a digit directly rules out the other digits
+// of the cell and the digit in its peers. All other clauses are visited through their watches. Returns REASON_NONE, or the conflict: a clause
+// reference, or -2 - lit for the implicit binary clause (not lit or not the placing literal) written to *conflictLit.
+static int propagate(Sat *s, int *conflictLit) {
+    const Geometry *g = s->geom;
+    int n = s->n;
+    while (s->qhead < s->trailSize) {
+        int p = s->trail[s->qhead++];
+        s->propagations++;
+
+        if (!LIT_NEG(p)) {  // Cell takes a digit: its other digits and the digit in its peers become false
+            int var = LIT_VAR(p), cell = var / n, digit = var % n;
+            for (int k = g->peerStart[cell]; k < g->peerStart[cell + 1] + n; k++) {
+                int other;
+                if (k < g->peerStart[cell + 1]) {
+                    other = g->peers[k] * n + digit;
+                } else {
+                    int d = k - g->peerStart[cell + 1];
+                    if (d == digit) continue;
+                    other = cell * n + d;
+                }
+                int value = s->assign[other];
+                if (value == 0) continue;
+                if (value == 1) {
+                    *conflictLit = LIT(other, 1);
+                    return -2 - (p ^ 1);
+                }
+                enqueue(s, LIT(other, 1), -2 - (p ^ 1));
+            }
+        }
+
+        WatchList *list = &s->watches[p];
+        int falseLit = p ^ 1, i = 0, j = 0;
+        while (i < list->count) {
+            Watch w = list->items[i];
+            if (litValue(s, w.blocker) == 1) {
+                list->items[j++] = list->items[i++];
+                continue;
+            }
+            int *lits = &s->arena[w.clause + 2];
+            if (lits[0] == falseLit) {
+                lits[0] = lits[1];
+                lits[1] = falseLit;
+            }
+            i++;
+            int first = lits[0];
+            if (first != w.blocker && litValue(s, first) == 1) {
+                w.blocker = first;
+                list->items[j++] = w;
+                continue;
+            }
+            w.blocker = first;
+
+            // Look for a literal that is not false to watch instead
+            int size = s->arena[w.clause], moved = 0;
+            for (int k = 2; k < size; k++) {
+                if (litValue(s, lits[k]) != 0) {
+                    lits[1] = lits[k];
+                    lits[k] = falseLit;
+                    watchAdd(&s->watches[lits[1] ^ 1], w.clause, first);
+                    moved = 1;
+                    break;
+                }
+            }
+            if (moved) continue;
+
+            list->items[j++] = w;
+            if (litValue(s, first) == 0) {  // Every literal is false
+                while (i < list->count) list->items[j++] = list->items[i++];
+                list->count = j;
+                s->qhead = s->trailSize;
+                return w.clause;
+            }
+            enqueue(s, first, w.clause);
+        }
+        list->count = j;
+    }
+    return REASON_NONE;
+}
+
+// Function to derive a learnt clause from a conflict (first unique implication point), minimize it
+// and return the level to go back to. The clause is left in s->learnt with its asserting literal first.
+static int analyze(Sat *s, int conflict, int conflictLit, int *learntSize, int *lbd) {
+    int buffer[2], count, pathCount = 0, p = -1, index = s->trailSize - 1, size = 1;
+    const int *lits = reasonLits(s, conflict, conflictLit, buffer, &count);
+
+    for (;;) {
+        for (int k = p < 0 ? 0 : 1; k < count; k++) {
+            int q = lits[k], var = LIT_VAR(q);
+            if (s->seen[var] || s->level[var] == 0) continue;
+            s->seen[var] = 1;
+            bumpVar(s, var);
+            if (s->level[var] >= s->levels)
+                pathCount++;
+            else
+                s->learnt[size++] = q;
+        }
+        while (!s->seen[LIT_VAR(s->trail[index])]) index--;
+        p = s->trail[index--];
+        s->seen[LIT_VAR(p)] = 0;
+        if (--pathCount == 0) break;
+        lits = reasonLits(s, s->reason[LIT_VAR(p)], p, buffer, &count);
+    }
+    s->learnt[0] = p ^ 1;
+
+    // Drop literals implied by the others: all of their reason is already in the clause. Dropped literals
+    // are swapped behind the kept ones, so their marks can still be cleared afterwards.
+    int kept = 1;
+    for (int k = 1; k < size; k++) {
+        int lit = s->learnt[k], redundant = s->reason[LIT_VAR(lit)] != REASON_NONE;
+        if (redundant) {
+            const int *r = reasonLits(s, s->reason[LIT_VAR(lit)], lit ^ 1, buffer, &count);
+            for (int m = 1; m < count && redundant; m++)
+                redundant = s->seen[LIT_VAR(r[m])] || s->level[LIT_VAR(r[m])] == 0;
+        }
+        if (!redundant) {
+            s->learnt[k] = s->learnt[kept];
+            s->learnt[kept++] = lit;
+        }
+    }
+    for (int k = 1; k < size; k++) s->seen[LIT_VAR(s->learnt[k])] = 0;
+    size = kept;
+
+    // Back jump to the highest level below the conflict; that literal becomes the second watch
+    int back = 0;
+    if (size > 1) {
+        int best = 1;
+        for (int k = 2; k < size; k++)
+            if (s->level[LIT_VAR(s->learnt[k])] > s->level[LIT_VAR(s->learnt[best])]) best = k;
+        int tmp = s->learnt[1];
+        s->learnt[1] = s->learnt[best];
+        s->learnt[best] = tmp;
+        back = s->level[LIT_VAR(s->learnt[1])];
+    }
+
+    s->stampNow++;
+    *lbd = 0;
+    for (int k = 0; k < size; k++) {
+        int level = s->level[LIT_VAR(s->learnt[k])];
+        if (s->stamp[level] != s->stampNow) {
+            s->stamp[level] = s->stampNow;
+            (*lbd)++;
+        }
+    }
+    *learntSize = size;
+    return back;
+}
+
+// Function to move the live clauses to a fresh arena and rebuild the watches
+static void collectGarbage(Sat *s) {
+    int *arena = malloc(s->arenaCap * sizeof(int));
+    size_t used = 0;
+    for (int list = 0; list < 2; list++) {
+        int *refs = list ? s->learnts : s->problem;
+        int count = list ? s->learntCount : s->problemCount;
+        for (int i = 0; i < count; i++) {
+            int old = refs[i], size = s->arena[old] + 2;
+            memcpy(&arena[used], &s->arena[old], size * sizeof(int));
+            s->arena[old] = CLAUSE_MOVED;
+            s->arena[old + 1] = (int) used;
+            refs[i] = (int) used;
+            used += size;
+        }
+    }
+    for (int i = 0; i < s->trailSize; i++) {
+        int var = LIT_VAR(s->trail[i]);
+        if (s->reason[var] >= 0)
+            s->reason[var] = s->arena[s->reason[var] + 1];  // Reasons are never deleted, so they were moved
+    }
+    free(s->arena);
+    s->arena = arena;
+    s->arenaSize = used;
+    for (int lit = 0; lit < 2 * s->vars; lit++) s->watches[lit].count = 0;
+    for (int i = 0; i < s->problemCount; i++) attachClause(s, s->problem[i]);
+    for (int i = 0; i < s->learntCount; i++) attachClause(s, s->learnts[i]);
+}
+
+static const Sat *sortSat;  // Solver whose learnt clauses compareLearnts is sorting
+
+// Worst clauses last: high LBD first, then the longer ones
+static int compareLearnts(const void *a, const void *b) {
+    const int *arena = sortSat->arena;
+    int x = *(const int *) a, y = *(const int *) b;
+    int lx = arena[x + 1] >> 2, ly = arena[y + 1] >> 2;
+    if (lx != ly) return lx - ly;
+    return arena[x] - arena[y];
+}
+
+// Function to remove the worse half of the learnt clauses, keeping those with a small LBD
+// and those that are the reason of an assignment
+static void reduceLearnts(Sat *s) {
+    sortSat = s;
+    qsort(s->learnts, s->learntCount, sizeof(int), compareLearnts);
+    int kept = 0;
+    for (int i = 0; i < s->learntCount; i++) {
+        int clause = s->learnts[i], first = s->arena[clause + 2];
+        int locked = s->reason[LIT_VAR(first)] == clause && litValue(s, first) == 1;
+        if (i < s->learntCount / 2 || (s->arena[clause + 1] >> 2) <= SAT_GLUE_KEEP || locked)
+            s->learnts[kept++] = clause;
+    }
+    s->learntCount = kept;
+    s->reductions++;
+    collectGarbage(s);
+}
+
+// Function to get element i of the Luby sequence 1 1 2 1 1 2 4 1 1 2 ... (restart intervals)
+static double luby(int i) {
+    int size = 1, seq = 0;
+    while (size < i + 1) {
+        seq++;
+        size = 2 * size + 1;
+    }
+    double value = 1;
+    while (size - 1 != i) {
+        size = (size - 1) >> 1;
+        seq--;
+        i %= size;
+    }
+    for (int k = 0; k < seq; k++) value *= 2;
+    return value;
+}
+
+// Function to add an encoding clause after dropping the literals that are already false.
+// Returns 0 if it cannot be satisfied any more.
+static int addProblemClause(Sat *s, int *lits, int count) {
+    int kept = 0;
+    for (int k = 0; k < count; k++) {
+        int value = litValue(s, lits[k]);
+        if (value == 1) return 1;  // Already satisfied by the givens
+        if (value < 0) lits[kept++] = lits[k];
+    }
+    if (kept == 0) return 0;
+    if (kept == 1) {
+        int conflictLit;
+        enqueue(s, lits[0], REASON_NONE);
+        return propagate(s, &conflictLit) == REASON_NONE;
+    }
+    s->problem[s->problemCount++] = addClause(s, lits, kept, 0, 0);
+    return 1;
+}
+
+// Function to build the encoding of the board: the givens and everything they imply are assigned at
+// level 0, then every cell needs a digit and every unit needs every digit. Returns 0 if the givens conflict.
+static int encode(Sat *s, int **board) {
+    const Geometry *g = s->geom;
+    int n = s->n, conflictLit, ok = 1;
+    for (int cell = 0; cell < g->cells && ok; cell++) {
+        int v = board[g->cellRow[cell]][g->cellCol[cell]];
+        if (v == 0) continue;
+        int lit = LIT(cell * n + v - 1, 0);
+        if (litValue(s, lit) == 0) ok = 0;
+        else if (litValue(s, lit) < 0) enqueue(s, lit, REASON_NONE);
+        ok = ok && propagate(s, &conflictLit) == REASON_NONE;
+    }
+
+    int *lits = malloc(n * sizeof(int));
+    s->problem = malloc((g->cells + g->units * n) * sizeof(int));
+    for (int cell = 0; cell < g->cells && ok; cell++) {
+        for (int v = 0; v < n; v++) lits[v] = LIT(cell * n + v, 0);
+        ok = addProblemClause(s, lits, n);
+    }
+    for (int u = 0; u < g->units && ok; u++) {
+        for (int v = 0; v < n && ok; v++) {
+            for (int k = 0; k < n; k++) lits[k] = LIT(g->unitCells[u * n + k] * n + v, 0);
+            ok = addProblemClause(s, lits, n);
+        }
+    }
+    free(lits);
+    return ok;
+}
+
+static void satInit(Sat *s, const Geometry *g) {
+    memset(s, 0, sizeof(Sat));
+    s->geom = g;
+    s->n = g->size;
+    s->vars = g->cells * g->size;
+    s->assign = malloc(s->vars);
+    memset(s->assign, -1, s->vars);
+    s->level = calloc(s->vars, sizeof(int));
+    s->reason = malloc(s->vars * sizeof(int));
+    s->trail = malloc(s->vars * sizeof(int));
+    s->trailLimit = malloc((s->vars + 1) * sizeof(int));
+    s->watches = calloc(2 * s->vars, sizeof(WatchList));
+    s->activity = calloc(s->vars, sizeof(double));
+    s->varInc = 1;
+    s->heap = malloc(s->vars * sizeof(int));
+    s->heapIndex = malloc(s->vars * sizeof(int));
+    s->phase = malloc(s->vars);
+    memset(s->phase, 1, s->vars);  // Try placing digits first
+    s->seen = calloc(s->vars, 1);
+    s->stamp = calloc(s->vars + 1, sizeof(int));
+    s->learnt = malloc((s->vars + 1) * sizeof(int));
+    for (int v = 0; v < s->vars; v++) s->heapIndex[v] = -1;
+}
+
+static void satFree(Sat *s) {
+    for (int lit = 0; lit < 2 * s->vars; lit++) free(s->watches[lit].items);
+    free(s->watches);
+    free(s->assign);
+    free(s->level);
+    free(s->reason);
+    free(s->trail);
+    free(s->trailLimit);
+    free(s->arena);
+    free(s->problem);
+    free(s->learnts);
+    free(s->activity);
+    free(s->heap);
+    free(s->heapIndex);
+    free(s->phase);
+    free(s->seen);
+    free(s->stamp);
+    free(s->learnt);
+}
+
+// Function to run the CDCL search; returns SOLVE_SOLVED, SOLVE_UNSOLVED (no solution) or the limit that stopped it
+static SolveStatus search(Sat *s, SolveProgress *progress) {
+    // Start with the digits of the cells that have the fewest candidates left, like the backtracking solvers
+    int n = s->n;
+    for (int cell = 0; cell < s->geom->cells; cell++) {
+        int free = 0;
+        for (int v = 0; v < n; v++) free += s->assign[cell * n + v] < 0;
+        for (int v = 0; v < n; v++) {
+            if (s->assign[cell * n + v] >= 0) continue;
+            s->activity[cell * n + v] = 1.0 / free;
+            heapInsert(s, cell * n + v);
+        }
+    }
+
+    long long nextRestart = SAT_RESTART_BASE, nextReduce = SAT_REDUCE_FIRST, reduceStep = SAT_REDUCE_FIRST;
+    long long sinceRestart = 0;
+    for (;;) {
+        int conflictLit, conflict = propagate(s, &conflictLit);
+        if (conflict != REASON_NONE) {
+            s->conflicts++;
+            sinceRestart++;
+            progress->iterations++;
+            metrics_add(METRIC_SAT_CONFLICTS, 1);
+            if (s->levels == 0)
+                return SOLVE_UNSOLVED;  // Conflict without any decision: no solution
+
+            int size, lbd, back = analyze(s, conflict, conflictLit, &size, &lbd);
+            cancelUntil(s, back);
+            if (size == 1) {
+                enqueue(s, s->learnt[0], REASON_NONE);
+            } else {
+                if (s->learntCount == s->learntCap) {
+                    s->learntCap = s->learntCap ? 2 * s->learntCap : 1024;
+                    s->learnts = realloc(s->learnts, s->learntCap * sizeof(int));
+                }
+                int clause = addClause(s, s->learnt, size, 1, lbd);
+                s->learnts[s->learntCount++] = clause;
+                enqueue(s, s->learnt[0], clause);
+            }
+            s->varInc /= SAT_VAR_DECAY;
+
+            SolveStatus status = solve_check(progress);
+            if (status != SOLVE_RUNNING)
+                return status;
+            continue;
+        }
+
+        if (sinceRestart >= nextRestart) {
+            s->restarts++;
+            sinceRestart = 0;
+            nextRestart = (long long) (SAT_RESTART_BASE * luby(s->restarts));
+            cancelUntil(s, 0);
+        }
+        if (s->conflicts >= nextReduce) {
+            reduceStep += SAT_REDUCE_STEP;
+            nextReduce = s->conflicts + reduceStep;
+            reduceLearnts(s);
+        }
+
+        // Next decision: the most active unassigned variable, in its saved phase
+        int var = -1;
+        while (s->heapSize > 0 && s->assign[var = heapPop(s)] >= 0)
+            var = -1;
+        if (var < 0)
+            return SOLVE_SOLVED;  // Every variable is assigned without conflict
+        s->decisions++;
+        metrics_add(METRIC_SAT_DECISIONS, 1);
+        s->trailLimit[s->levels++] = s->trailSize;
+        enqueue(s, LIT(var, !s->phase[var]), REASON_NONE);
+    }
+}
+
+// Function to solve a puzzle of any size (and variant) with a CDCL SAT solver. The board is encoded with
+// one variable per cell and digit; the givens are propagated before the search, one digit per cell and no
+// repeated digit in a unit are implicit binary clauses, and "every cell has a digit" and "every unit has
+// every digit" are real clauses. Iterations are conflicts. The energy of the result is the number of cells
+// left empty.
+SolveResult solveSAT(int **board, const SolveLimits *limits) {
+    SolveProgress progress;
+    solve_begin(&progress, limits, 0);
+    const Geometry *g = geometry_current();
+
+    Sat s;
+    TRACE_BEGIN(encode);
+    satInit(&s, g);
+    int ok = encode(&s, board);
+    TRACE_END(encode, "SAT encoding");
+    int variables = 0;
+    for (int v = 0; v < s.vars; v++) variables += s.assign[v] < 0;
+    if (ok)
+        printf("SAT encoding: %d of %d variables left after the givens, %d clauses\n", variables, s.vars, s.problemCount);
+    else
+        printf("SAT encoding: the givens contradict each other\n");
+    metrics_phase(PHASE_SETUP, solver_clock() - progress.start);
+
+    TRACE_BEGIN(search);
+    SolveStatus status = ok ? search(&s, &progress) : SOLVE_UNSOLVED;
+    TRACE_END(search, "SAT search");
+    printf("SAT search: %lld decisions, %lld conflicts, %lld propagations, %d restarts, %d cleanups, %d learnt clauses kept\n",
+           s.decisions, s.conflicts, s.propagations, s.restarts, s.reductions, s.learntCount);
+
+    int empty = 0;
+    for (int cell = 0; cell < g->cells; cell++) {
+        int r = g->cellRow[cell], c = g->cellCol[cell];
+        if (status == SOLVE_SOLVED) {
+            for (int v = 0; v < s.n; v++)
+                if (s.assign[cell * s.n + v] == 1) board[r][c] = v + 1;
+        }
+        if (board[r][c] == 0) empty++;
+    }
+    if (status != SOLVE_SOLVED && empty == 0)
+        empty = 1;  // Full board with conflicting givens
+    satFree(&s);
+    return solve_finish(&progress, status == SOLVE_SOLVED ? SOLVE_RUNNING : status, empty);
+}
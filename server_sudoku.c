@@ -0,0 +1,496 @@
+#define _POSIX_C_SOURCE 200809L  // open_memstream
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "sudoku.h"
+
+#define SERVER_MAX_CLIENTS 64
+#define SERVER_LINE_MAX 256       // Longest text request
+#define SERVER_BINARY_MAGIC 0xFF  // First byte of a binary request; text requests never start with it
+#define SERVER_BINARY_REQUEST (1 + 4 + BATCH_CELLS)       // Magic, id, cells
+#define SERVER_BINARY_RESPONSE (1 + 4 + 1 + BATCH_CELLS)  // Magic, id, status, cells
+#define SERVER_READ_CHUNK 4096
+#define SERVER_MAX_PENDING 1024         // Requests of one connection queued or being solved
+#define SERVER_MAX_OUTPUT (1 << 20)     // Bytes of answers waiting for a connection to read them
+
+// Status byte of a binary response
+enum { REPLY_SOLVED = 0, REPLY_UNSOLVABLE = 1, REPLY_INVALID = 2 };
+
+// One client connection. in/inLen belong to the event loop; out, pending and the rest are guarded by the server lock.
+typedef struct {
+    int fd;
+    int open;                          // Cleared once the client stopped sending
+    int pending;                       // Requests queued or being solved
+    char in[SERVER_READ_CHUNK + SERVER_LINE_MAX];
+    int inLen;
+    char *out;                         // Responses not yet written to the socket
+    size_t outLen, outCap;
+} Connection;
+
+// One puzzle waiting for a worker
+typedef struct {
+    Connection *conn;
+    unsigned int id;
+    int binary;                        // Answer in the binary format
+    int generate;                      // GEN request: clues of the puzzle to make (0 = solve cells)
+    int cells[BATCH_CELLS];
+} Request;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    Request *queue;                    // Ring buffer of requests
+    int head, count, cap;
+    Connection *clients[SERVER_MAX_CLIENTS];
+    int wake[2];                       // Workers write to wake[1] when responses are ready
+    atomic_int stop;
+} server;
+
+// Signal handler: SIGINT and SIGTERM shut the server down. The byte on the wake pipe ends a poll
+// that started after the event loop last looked at the stop flag.
+static void stopServer(int signo) {
+    (void) signo;
+    atomic_store(&server.stop, 1);
+    if (write(server.wake[1], "", 1) < 0) {
+        // The pipe is full: the event loop wakes up anyway
+    }
+}
+
+// Function to check whether a connection has as much work in flight as it may (server lock held).
+// Its requests are then left unread, so a client that sends faster than it reads gets backpressure
+// instead of growing the queue and its output without bound.
+static int throttled(const Connection *conn) {
+    return conn->pending >= SERVER_MAX_PENDING || conn->outLen >= SERVER_MAX_OUTPUT;
+}
+
+// Function to append bytes to the output of a connection (server lock held)
+static void appendOutput(Connection *conn, const void *data, size_t len) {
+    if (conn->outLen + len > conn->outCap) {
+        conn->outCap = (conn->outLen + len) * 2;
+        conn->out = realloc(conn->out, conn->outCap);
+    }
+    memcpy(conn->out + conn->outLen, data, len);
+    conn->outLen += len;
+}
+
+// Function to append the response to one request (server lock held)
+static void appendResponse(Connection *conn, unsigned int id, int binary, int reply, const int cells[BATCH_CELLS]) {
+    if (binary) {
+        unsigned char frame[SERVER_BINARY_RESPONSE];
+        frame[0] = SERVER_BINARY_MAGIC;
+        for (int b = 0; b < 4; b++) frame[1 + b] = (unsigned char) (id >> (8 * b));  // Little endian
+        frame[5] = (unsigned char) reply;
+        for (int i = 0; i < BATCH_CELLS; i++) frame[6 + i] = reply == REPLY_SOLVED ? (unsigned char) cells[i] : 0;
+        appendOutput(conn, frame, sizeof(frame));
+        return;
+    }
+
+    char line[32 + BATCH_CELLS];
+    int n = snprintf(line, sizeof(line), "%u ", id);
+    if (reply == REPLY_SOLVED) {
+        for (int i = 0; i < BATCH_CELLS; i++) line[n++] = (char) ('0' + cells[i]);
+        line[n++] = '\n';
+    } else {
+        n += snprintf(line + n, sizeof(line) - n, "%s\n", reply == REPLY_INVALID ? "invalid" : "unsolvable");
+    }
+    appendOutput(conn, line, n);
+}
+
+// Function to make a puzzle with the given number of clues for a GEN request. Puzzles come from the
+// background pool; only when it ran dry is one generated here, on the worker.
+static void makePuzzle(int clueCount, int cells[BATCH_CELLS]) {
+    int fixedCells[BATCH_CELLS];
+    if (pool_take(BATCH_SIZE, 3, VARIANT_CLASSIC, clueCount, cells, fixedCells))
+        return;
+    memset(cells, 0, BATCH_CELLS * sizeof(int));
+    generateCells(geometry_get(BATCH_SIZE, 3), cells);
+    removeCells(BATCH_SIZE, BATCH_CELLS - clueCount, cells, fixedCells);
+}
+
+// Function to append a generated puzzle as 81 cells, 0 for empty (server lock held)
+static void appendPuzzle(Connection *conn, const int cells[BATCH_CELLS]) {
+    char line[BATCH_CELLS + 1];
+    for (int i = 0; i < BATCH_CELLS; i++) line[i] = (char) ('0' + cells[i]);
+    line[BATCH_CELLS] = '\n';
+    appendOutput(conn, line, sizeof(line));
+}
+
+// Thread function: take up to BATCH_LANES queued requests at a time and solve them in one batch.
+// Batches fill up by themselves under load and stay small (low latency) when the server is idle.
+// GEN requests taken along are answered with a puzzle each, made outside the lock.
+static void *serverWorker(void *arg) {
+    TRACE_THREAD("server worker");
+    rng_seed(randomSeed + 1 + (intptr_t) arg);  // Puzzles generated by different workers differ
+    Request batch[BATCH_LANES];
+    int puzzles[BATCH_LANES][BATCH_CELLS], solutions[BATCH_LANES][BATCH_CELLS], results[BATCH_LANES];
+    int lane[BATCH_LANES];  // Request of every lane of the solved batch
+    unsigned char grids[BATCH_LANES * BATCH_CELLS], clues[BATCH_LANES * BATCH_CELLS], valid[BATCH_LANES];
+
+    while (1) {
+        pthread_mutex_lock(&server.lock);
+        while (server.count == 0 && !atomic_load(&server.stop))
+            pthread_cond_wait(&server.work, &server.lock);
+        if (server.count == 0) {
+            pthread_mutex_unlock(&server.lock);
+            return NULL;  // Stopping and nothing left to do
+        }
+        int count = server.count < BATCH_LANES ? server.count : BATCH_LANES;
+        for (int k = 0; k < count; k++) {
+            batch[k] = server.queue[server.head];
+            server.head = (server.head + 1) % server.cap;
+        }
+        server.count -= count;
+        pthread_mutex_unlock(&server.lock);
+
+        int lanes = 0;
+        for (int k = 0; k < count; k++) {
+            if (batch[k].generate > 0) {
+                makePuzzle(batch[k].generate, batch[k].cells);
+                continue;
+            }
+            lane[lanes] = k;
+            memcpy(puzzles[lanes++], batch[k].cells, sizeof(puzzles[0]));
+        }
+        if (lanes > 0) {
+            batch_solve(puzzles, lanes, solutions, results);
+
+            // Check every answer before it is served; lanes without a solution fail the check anyway
+            for (int k = 0; k < lanes; k++) {
+                for (int i = 0; i < BATCH_CELLS; i++) {
+                    grids[k * BATCH_CELLS + i] = (unsigned char) (results[k] ? solutions[k][i] : 0);
+                    clues[k * BATCH_CELLS + i] = (unsigned char) puzzles[k][i];
+                }
+            }
+            validate_grids(grids, clues, lanes, valid);
+        }
+
+        pthread_mutex_lock(&server.lock);
+        for (int k = 0; k < lanes; k++) {
+            Request *request = &batch[lane[k]];
+            appendResponse(request->conn, request->id, request->binary,
+                           valid[k] ? REPLY_SOLVED : REPLY_UNSOLVABLE, solutions[k]);
+        }
+        for (int k = 0; k < count; k++) {
+            if (batch[k].generate > 0) appendPuzzle(batch[k].conn, batch[k].cells);
+            batch[k].conn->pending--;
+        }
+        pthread_mutex_unlock(&server.lock);
+        if (write(server.wake[1], "", 1) < 0) {
+            // The pipe is full: the event loop has wake-ups pending anyway
+        }
+    }
+}
+
+// Function to queue one parsed request for the workers: a puzzle to solve, or with generate > 0 and
+// cells NULL a puzzle to make (server lock held)
+static void enqueueRequest(Connection *conn, unsigned int id, int binary, int generate, const int cells[BATCH_CELLS]) {
+    if (server.count == server.cap) {
+        int newCap = server.cap ? 2 * server.cap : 256;
+        Request *queue = malloc(newCap * sizeof(Request));
+        for (int k = 0; k < server.count; k++)
+            queue[k] = server.queue[(server.head + k) % server.cap];
+        free(server.queue);
+        server.queue = queue;
+        server.head = 0;
+        server.cap = newCap;
+    }
+    Request *request = &server.queue[(server.head + server.count++) % server.cap];
+    request->conn = conn;
+    request->id = id;
+    request->binary = binary;
+    request->generate = generate;
+    if (cells != NULL)
+        memcpy(request->cells, cells, sizeof(request->cells));
+    conn->pending++;
+}
+
+// Function to handle one text line: "<id> <81 cells>", "GEN <clues>", "STATS" or "QUIT" (server lock held).
+// Returns 0 if the client asked to close the connection.
+static int handleTextLine(Connection *conn, char *line) {
+    if (strcmp(line, "QUIT") == 0)
+        return 0;
+    if (strcmp(line, "STATS") == 0) {
+        char *text;
+        size_t len;
+        FILE *mem = open_memstream(&text, &len);
+        metrics_write(mem, METRICS_JSON);
+        fclose(mem);
+        appendOutput(conn, text, len);
+        free(text);
+        return 1;
+    }
+    if (strncmp(line, "GEN ", 4) == 0) {
+        char *end;
+        long clueCount = strtol(line + 4, &end, 10);
+        if (end == line + 4 || *end != '\0' || clueCount < 17 || clueCount > BATCH_CELLS)
+            appendOutput(conn, "error\n", 6);
+        else
+            enqueueRequest(conn, 0, 0, (int) clueCount, NULL);  // Answered by a worker, off the event loop
+        return 1;
+    }
+
+    char *end;
+    unsigned long id = strtoul(line, &end, 10);
+    int cells[BATCH_CELLS];
+    if (end == line || *end != ' ') {
+        appendOutput(conn, "error\n", 6);  // No request id to tag the answer with
+    } else if (!batch_parse(end + 1, cells)) {
+        appendResponse(conn, (unsigned int) id, 0, REPLY_INVALID, NULL);
+    } else {
+        enqueueRequest(conn, (unsigned int) id, 0, 0, cells);
+    }
+    return 1;
+}
+
+// Function to take the complete requests out of the input buffer of a connection, as long as it is not
+// throttled (server lock held). Returns 0 if the client asked to close the connection.
+static int parseRequests(Connection *conn) {
+    int pos = 0, keep = 1, queued = 0;
+    while (pos < conn->inLen && keep && !throttled(conn)) {
+        unsigned char *p = (unsigned char *) conn->in + pos;
+        int left = conn->inLen - pos;
+
+        if (p[0] == SERVER_BINARY_MAGIC) {
+            if (left < SERVER_BINARY_REQUEST) break;  // Wait for the rest of the frame
+            unsigned int id = p[1] | p[2] << 8 | p[3] << 16 | (unsigned int) p[4] << 24;
+            int cells[BATCH_CELLS], valid = 1;
+            for (int i = 0; i < BATCH_CELLS; i++) {
+                cells[i] = p[5 + i];
+                if (cells[i] > BATCH_SIZE) valid = 0;
+            }
+            if (valid) {
+                enqueueRequest(conn, id, 1, 0, cells);
+                queued++;
+            } else {
+                appendResponse(conn, id, 1, REPLY_INVALID, NULL);
+            }
+            pos += SERVER_BINARY_REQUEST;
+            continue;
+        }
+
+        char *newline = memchr(p, '\n', left);
+        if (newline == NULL) {
+            if (left >= SERVER_LINE_MAX) keep = 0;  // Overlong line: drop the client
+            break;
+        }
+        *newline = '\0';
+        if (newline > (char *) p && newline[-1] == '\r') newline[-1] = '\0';
+        int before = server.count;
+        if (p[0] != '\0')
+            keep = handleTextLine(conn, (char *) p);
+        queued += server.count - before;
+        pos += (int) (newline - (char *) p) + 1;
+    }
+    if (queued > 0)
+        pthread_cond_broadcast(&server.work);
+
+    memmove(conn->in, conn->in + pos, conn->inLen - pos);
+    conn->inLen -= pos;
+    return keep;
+}
+
+// Function to write as much pending output as the socket takes (server lock held)
+static void flushOutput(Connection *conn) {
+    size_t sent = 0;
+    while (sent < conn->outLen) {
+        ssize_t n = send(conn->fd, conn->out + sent, conn->outLen - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                conn->open = 0;  // Client went away: its answers are dropped
+                sent = conn->outLen;
+            }
+            break;
+        }
+        sent += n;
+    }
+    memmove(conn->out, conn->out + sent, conn->outLen - sent);
+    conn->outLen -= sent;
+}
+
+// Function to open the listening socket; returns -1 on error
+static int listenOn(const char *path) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("Socket path too long: %s\n", path);
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);  // Remove the socket of a previous run
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, SERVER_MAX_CLIENTS) < 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+// Function to accept a new client, or to turn it away when all slots are taken
+static void acceptClient(int listenFd) {
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0)
+        return;
+    for (int c = 0; c < SERVER_MAX_CLIENTS; c++) {
+        if (server.clients[c] == NULL) {
+            Connection *conn = calloc(1, sizeof(Connection));
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            conn->fd = fd;
+            conn->open = 1;
+            server.clients[c] = conn;
+            return;
+        }
+    }
+    close(fd);
+}
+
+// Function to serve 9x9 puzzles on a Unix socket until SIGINT or SIGTERM.
+// Text requests are lines "<id> <81 cells>" answered by "<id> <solution>", "<id> unsolvable" or
+// "<id> invalid", and "GEN <clues>" answered by a new puzzle; binary requests are 0xFF, a 32-bit
+// little endian id and 81 cell bytes, answered by 0xFF, the id, a status byte and 81 cells.
+// Answers can come back in any order; the id tells them apart.
+int runServer(const char *socketPath, int workers) {
+    int listenFd = listenOn(socketPath);
+    if (listenFd < 0)
+        return 1;
+    if (pipe(server.wake) < 0) {
+        perror("pipe");
+        close(listenFd);
+        return 1;
+    }
+    fcntl(server.wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(server.wake[1], F_SETFL, O_NONBLOCK);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopServer;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    if (workers <= 0)
+        workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers <= 0)
+        workers = 1;
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.work, NULL);
+    batch_prepare();  // Lookup tables are built once and stay warm for every request
+    geometry_get(BATCH_SIZE, 3);  // Built here, before any thread could ask for it
+    pthread_t *threads = malloc(workers * sizeof(pthread_t));
+    sigset_t stopSignals, oldMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &oldMask);  // Workers inherit the mask: signals go to the poll loop
+    for (int w = 0; w < workers; w++)
+        pthread_create(&threads[w], NULL, serverWorker, (void *) (intptr_t) w);
+    pool_start();  // Puzzles for GEN requests
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+    printf("Serving on %s with %d workers.\n", socketPath, workers);
+    fflush(stdout);
+
+    struct pollfd fds[SERVER_MAX_CLIENTS + 2];
+    int owner[SERVER_MAX_CLIENTS + 2];
+    while (!atomic_load(&server.stop)) {
+        int n = 0;
+        fds[n].fd = listenFd;
+        fds[n++].events = POLLIN;
+        fds[n].fd = server.wake[0];
+        fds[n++].events = POLLIN;
+        pthread_mutex_lock(&server.lock);
+        for (int c = 0; c < SERVER_MAX_CLIENTS; c++) {
+            Connection *conn = server.clients[c];
+            if (conn == NULL) continue;
+            if (conn->open && conn->inLen > 0 && !throttled(conn) && !parseRequests(conn))
+                conn->open = 0;  // Requests held back while the connection was throttled
+            fds[n].events = (conn->open && !throttled(conn) ? POLLIN : 0) | (conn->outLen > 0 ? POLLOUT : 0);
+            fds[n].fd = fds[n].events ? conn->fd : -1;  // Nothing to do until the workers answer
+            owner[n++] = c;
+        }
+        pthread_mutex_unlock(&server.lock);
+
+        if (poll(fds, n, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if (fds[0].revents & POLLIN)
+            acceptClient(listenFd);
+        if (fds[1].revents & POLLIN) {
+            char drain[256];
+            while (read(server.wake[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        for (int k = 2; k < n; k++) {
+            Connection *conn = server.clients[owner[k]];
+            // Throttled connections are not read, even on a hangup: their buffer may hold requests
+            if ((fds[k].events & POLLIN) && (fds[k].revents & (POLLIN | POLLHUP | POLLERR))) {
+                ssize_t got = conn->open ? read(conn->fd, conn->in + conn->inLen, SERVER_READ_CHUNK) : 0;
+                if (got > 0) {
+                    conn->inLen += got;
+                    pthread_mutex_lock(&server.lock);
+                    if (!parseRequests(conn)) conn->open = 0;
+                    pthread_mutex_unlock(&server.lock);
+                } else if (got == 0 || (errno != EAGAIN && errno != EINTR)) {
+                    conn->open = 0;  // Client finished sending; answer what it already asked
+                }
+            }
+        }
+
+        // Write ready answers and release connections that are done
+        pthread_mutex_lock(&server.lock);
+        for (int c = 0; c < SERVER_MAX_CLIENTS; c++) {
+            Connection *conn = server.clients[c];
+            if (conn == NULL) continue;
+            if (conn->outLen > 0) flushOutput(conn);
+            if (!conn->open && conn->pending == 0 && conn->outLen == 0) {
+                close(conn->fd);
+                free(conn->out);
+                free(conn);
+                server.clients[c] = NULL;
+            }
+        }
+        pthread_mutex_unlock(&server.lock);
+    }
+
+    // Let the workers finish the queue, then drop the remaining clients
+    pthread_mutex_lock(&server.lock);
+    atomic_store(&server.stop, 1);
+    pthread_cond_broadcast(&server.work);
+    pthread_mutex_unlock(&server.lock);
+    for (int w = 0; w < workers; w++)
+        pthread_join(threads[w], NULL);
+    for (int c = 0; c < SERVER_MAX_CLIENTS; c++) {
+        Connection *conn = server.clients[c];
+        if (conn == NULL) continue;
+        flushOutput(conn);
+        close(conn->fd);
+        free(conn->out);
+        free(conn);
+        server.clients[c] = NULL;
+    }
+    free(threads);
+    free(server.queue);
+    close(server.wake[0]);
+    close(server.wake[1]);
+    close(listenFd);
+    unlink(socketPath);
+    printf("Server stopped.\n");
+    return 0;
+}
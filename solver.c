@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <time.h>
+#include "sudoku.h"
+
+#define SOLVE_CLOCK_INTERVAL 64  // solve_check reads the clock once per this many calls
+
+// Function to read a monotonic clock in seconds
+double solver_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Function to build limits that expire after the given number of seconds (0 = no deadline)
+SolveLimits solve_limits(double seconds, long long maxIterations) {
+    SolveLimits limits;
+    limits.deadline = seconds > 0 ? solver_clock() + seconds : 0;
+    limits.max_iterations = maxIterations;
+    limits.cancel = NULL;
+    return limits;
+}
+
+// Function to start measuring a solver run; defaultBudget is used when the limits give no budget
+void solve_begin(SolveProgress *progress, const SolveLimits *limits, long long defaultBudget) {
+    progress->limits = limits;
+    progress->budget = limits != NULL && limits->max_iterations > 0 ? limits->max_iterations : defaultBudget;
+    progress->iterations = 0;
+    progress->start = solver_clock();
+    progress->ticks = 0;
+}
+
+// Function to check if a solver must stop; returns SOLVE_RUNNING to continue.
+// Cheap enough for inner loops: the clock is only read every SOLVE_CLOCK_INTERVAL calls.
+SolveStatus solve_check(SolveProgress *progress) {
+    if (progress->budget > 0 && progress->iterations >= progress->budget)
+        return SOLVE_BUDGET;
+
+    const SolveLimits *limits = progress->limits;
+    if (limits == NULL)
+        return SOLVE_RUNNING;
+    if (limits->cancel != NULL && atomic_load_explicit(limits->cancel, memory_order_relaxed))
+        return SOLVE_CANCELLED;
+    if (limits->deadline > 0 && ++progress->ticks % SOLVE_CLOCK_INTERVAL == 0 && solver_clock() >= limits->deadline)
+        return SOLVE_TIMEOUT;
+    return SOLVE_RUNNING;
+}
+
+// Function to build the result of a finished run. A run that was not stopped by its limits
+// is reported as solved when no conflicts are left and as unsolved otherwise.
+SolveResult solve_finish(const SolveProgress *progress, SolveStatus status, int energy) {
+    SolveResult result;
+    result.status = energy == 0 ? SOLVE_SOLVED : (status == SOLVE_RUNNING ? SOLVE_UNSOLVED : status);
+    result.energy = energy;
+    result.iterations = progress->iterations;
+    result.elapsed = solver_clock() - progress->start;
+
+    metrics_add(METRIC_RUNS, 1);
+    if (result.status == SOLVE_SOLVED) metrics_add(METRIC_SOLVED, 1);
+    metrics_phase(PHASE_SOLVE, result.elapsed);
+    return result;
+}
+
+// Function to get a printable name of a solver status
+const char *solve_status_name(SolveStatus status) {
+    switch (status) {
+        case SOLVE_SOLVED: return "solved";
+        case SOLVE_UNSOLVED: return "not solved";
+        case SOLVE_TIMEOUT: return "deadline reached";
+        case SOLVE_BUDGET: return "iteration budget used up";
+        case SOLVE_CANCELLED: return "cancelled";
+        default: return "running";
+    }
+}
+
+// Function to print the result of a solver run
+void printSolveResult(const char *engine, SolveResult result) {
+    printf("%s: %s (energy %d, %lld iterations, %.3f s)\n", engine, solve_status_name(result.status),
+           result.energy, result.iterations, result.elapsed);
+}
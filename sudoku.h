@@ -0,0 +1,442 @@
+#ifndef SUDOKU_H
+#define SUDOKU_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+// Global variables for board size, subgrid height, and number of hints (defined in Sudoku.c).
+// Blocks are sub rows high and size / sub columns wide.
+extern int size, sub, hints;
+
+// Largest board size: the candidate set of a cell must fit in one DigitSet word
+#define MAX_SIZE 64
+
+typedef unsigned long long DigitSet;  // Bit v-1 is set when digit v is present (or allowed)
+typedef unsigned char cell_t;         // Compact cell value used inside the solvers (0 = empty)
+
+#define DIGIT_BIT(v) ((DigitSet) 1 << ((v) - 1))
+#define DIGIT_COUNT(set) __builtin_popcountll(set)
+
+#define UNITS_PER_CELL 3  // Row, column and box
+
+// Variant rules on top of rows, columns and boxes (flags, any combination)
+typedef enum {
+    VARIANT_CLASSIC = 0,
+    VARIANT_DIAGONAL = 1,     // Both main diagonals hold every digit once (Sudoku X)
+    VARIANT_WINDOKU = 2,      // So do the block-sized windows one line inside the blocks (hyper Sudoku)
+    VARIANT_ANTI_KNIGHT = 4,  // Cells a chess knight's move apart differ
+    VARIANT_ALL = 7
+} Variant;
+
+extern int variant;  // Variant of the current game (defined in Sudoku.c, set with --variant)
+
+// Lookup tables of one board shape, built once per size and variant (geometry.c).
+// Units are numbered rows 0..size-1, columns size..2*size-1, boxes 2*size..3*size-1, then the
+// extra units of the variant, which also have size cells each. Engines only look at the extra
+// units and pairs when g->variant is set, so classic boards keep their three-unit fast path.
+typedef struct {
+    int size;         // Digits per unit
+    int boxRows;      // Block height (the global sub)
+    int boxCols;      // Block width (size / boxRows)
+    int cells;        // size * size
+    int units;        // 3 * size plus the extra units
+    int *unitCells;   // unitCells[u * size + k] = k-th cell of unit u
+    int *cellUnits;   // cellUnits[cell * UNITS_PER_CELL + t] = row, column and box unit of the cell
+    int *cellRow;     // Row of every cell
+    int *cellCol;     // Column of every cell
+    int variant;      // Variant flags the tables were built for
+    int *extraStart;  // Extra units (diagonals, windows) of a cell: extraUnits[extraStart[cell]..extraStart[cell + 1] - 1]
+    int *extraUnits;
+    int *pairStart;   // Cells that must differ without sharing a unit (anti-knight): pairs[pairStart[cell]..pairStart[cell + 1] - 1]
+    int *pairs;
+    int *peerStart;   // Peers of a cell: peers[peerStart[cell]..peerStart[cell + 1] - 1]
+    int *peers;       // Cells sharing a unit with the cell, then its pair cells
+} Geometry;
+
+const Geometry *geometry_get(int n, int boxRows);
+const Geometry *geometry_variant(int n, int boxRows, int flags);
+const Geometry *geometry_current();
+int variant_parse(const char *text);
+const char *variant_describe(int flags);
+
+// Per-thread random numbers (rng.c), safe to use from solvers running in parallel
+#define RNG_MAX 0x7FFFFFFF
+extern unsigned long long randomSeed;  // Seed of the main thread; solver threads derive theirs from it
+void rng_seed(unsigned long long seed);
+int rng_next();
+unsigned long long rng_state();
+void rng_restore(unsigned long long state);
+
+// Limits given to a solver (solver.c); zero fields mean "no limit"
+typedef struct {
+    double deadline;            // solver_clock() time at which the solver must stop
+    long long max_iterations;   // Budget of nodes (backtracking), moves (SA, MC) or generations (GA)
+    const atomic_int *cancel;   // The solver stops once this flag is set (NULL = never)
+} SolveLimits;
+
+typedef enum {
+    SOLVE_RUNNING,     // Only used while a solver runs
+    SOLVE_SOLVED,      // No conflicts left
+    SOLVE_UNSOLVED,    // The solver finished its search without a solution
+    SOLVE_TIMEOUT,     // Deadline reached
+    SOLVE_BUDGET,      // Iteration budget used up
+    SOLVE_CANCELLED    // Cancel flag set
+} SolveStatus;
+
+// Outcome of one solver run
+typedef struct {
+    SolveStatus status;
+    int energy;              // Conflicts (or empty cells for backtracking) left on the board
+    long long iterations;    // Nodes, moves or generations used
+    double elapsed;          // Seconds
+} SolveResult;
+
+// Bookkeeping of a running solver
+typedef struct {
+    const SolveLimits *limits;
+    long long budget;        // Iteration limit (0 = none)
+    long long iterations;
+    double start;
+    unsigned int ticks;      // Calls of solve_check, to read the clock only now and then
+} SolveProgress;
+
+double solver_clock();
+SolveLimits solve_limits(double seconds, long long maxIterations);
+void solve_begin(SolveProgress *progress, const SolveLimits *limits, long long defaultBudget);
+SolveStatus solve_check(SolveProgress *progress);
+SolveResult solve_finish(const SolveProgress *progress, SolveStatus status, int energy);
+const char *solve_status_name(SolveStatus status);
+void printSolveResult(const char *engine, SolveResult result);
+
+// Board helpers (Sudoku.c)
+int isSupportedSize(int newSize, int newSub);
+int **allocate_board();
+void free_board(int **board);
+int readGame(FILE *file, int ***board, int ***fixed);
+void writeGame(FILE *file, int **board, int **fixed);
+int scanGame(FILE *file, int *n, int *boxRows, int *gameHints, int **cells, int **fixedCells);
+void writeGameCells(FILE *file, int n, int boxRows, int gameHints, const int *cells, const int *fixedCells);
+int isSafe(int **board, int row, int col, int num);
+int fillBoardBacktrack(int **board, int row, int col);
+SolveResult solveBacktrack(int **board, const SolveLimits *limits);
+SolveResult solveParallel(int **board, int threads, const SolveLimits *limits);  // parallel_sudoku.c
+SolveResult solveSAT(int **board, const SolveLimits *limits);                     // sat_sudoku.c
+extern int searchThreads;  // Threads of solveParallel chosen on the command line (0 = one per CPU)
+void generateBoard(int **board);
+void generateCells(const Geometry *g, int *cells);
+void removeCells(int n, int k, int *cells, int *fixedCells);
+
+// Puzzles generated ahead of time by a background thread, per board shape, variant and hints (pool_sudoku.c)
+void pool_start();
+void pool_prefetch(int n, int boxRows, int flags, int hints);
+int pool_take(int n, int boxRows, int flags, int hints, int *cells, int *fixedCells);
+
+// Digit counts of every unit, so a swap can be scored in O(1) (sa_sudoku.c, shared by the local searches)
+typedef struct {
+    const Geometry *geom;
+    unsigned char *count;  // count[u * (size + 1) + v] = how many times v appears in unit u
+    int conflicts;         // Repeated digits over all units
+} UnitCounts;
+
+void unit_counts_init(UnitCounts *uc, const Geometry *g, const cell_t *grid);
+void unit_counts_load(UnitCounts *uc, const cell_t *grid);
+void unit_counts_free(UnitCounts *uc);
+int unit_counts_swap_delta(const UnitCounts *uc, const cell_t *grid, int a, int b);
+int unit_counts_set_delta(const UnitCounts *uc, const cell_t *grid, int cell, int val);
+void unit_counts_set(UnitCounts *uc, cell_t *grid, int cell, int val);
+void unit_counts_swap(UnitCounts *uc, cell_t *grid, int a, int b);
+int unit_counts_cell_conflicts(const UnitCounts *uc, const cell_t *grid, int cell);
+
+// Board state of the block-preserving local searches (sa_sudoku.c)
+typedef struct {
+    const Geometry *geom;    // Board lookup tables
+    cell_t *grid;            // Board values, row by row (size * size cells)
+    unsigned char *fixed;    // 1 for cells given by the puzzle
+    int *movable;            // movable[b * size + k] = k-th unfixed cell of box b
+    int *movable_count;      // Number of unfixed cells in every box
+    UnitCounts counts;       // Digit counts, set up by initialize_state
+    int energy;              // Number of conflicts
+} SudokuState;
+
+void alloc_state(SudokuState *state);
+void free_state(SudokuState *state);
+void copy_state(SudokuState *dst, const SudokuState *src);
+void load_state(SudokuState *state, int **board);
+void initialize_state(SudokuState *state);
+
+// Solver counters (metrics.c). Every thread counts into its own slot with plain loads and
+// stores, so the hot loops never contend; exports add all slots up.
+typedef enum {
+    METRIC_NODES,           // Backtracking placements
+    METRIC_BACKTRACKS,      // Placements taken back
+    METRIC_PROPAGATIONS,    // Batch propagation passes over all units
+    METRIC_SA_ACCEPTED,     // Simulated annealing moves accepted
+    METRIC_SA_REJECTED,     // Simulated annealing moves rejected
+    METRIC_MC_MOVES,        // Min-conflicts moves
+    METRIC_MC_RESTARTS,     // Min-conflicts random restarts
+    METRIC_GA_EVALUATIONS,  // Fitness evaluations
+    METRIC_GA_GENERATIONS,  // Finished generations
+    METRIC_GA_RESTARTS,     // Population restarts after stagnation
+    METRIC_SAT_DECISIONS,   // CDCL decisions
+    METRIC_SAT_CONFLICTS,   // CDCL conflicts
+    METRIC_RUNS,            // Finished solver runs
+    METRIC_SOLVED,          // Runs that solved their board
+    METRIC_COUNT
+} MetricCounter;
+
+typedef enum {
+    PHASE_SETUP,      // Building the initial state or population
+    PHASE_SOLVE,      // Whole solver runs, setup included
+    PHASE_PROPAGATE,  // Batch constraint propagation
+    PHASE_FALLBACK,   // Batch backtracking on puzzles propagation could not finish
+    PHASE_COUNT
+} MetricPhase;
+
+typedef enum { METRICS_PROMETHEUS, METRICS_JSON } MetricsFormat;
+
+typedef struct {
+    _Alignas(64) atomic_ullong counter[METRIC_COUNT];  // Own cache lines: no false sharing between threads
+    atomic_ullong phaseNanos[PHASE_COUNT];
+    int shared;  // Overflow slot used by several threads: updates must be atomic additions
+} MetricsSlot;
+
+extern _Thread_local MetricsSlot *metricsSlot;
+MetricsSlot *metrics_register();
+
+// Function to add to a value of the calling thread's slot
+static inline void metrics_bump(atomic_ullong *value, unsigned long long n, int shared) {
+    if (shared)
+        atomic_fetch_add_explicit(value, n, memory_order_relaxed);
+    else  // Only this thread writes the value: no locked instruction needed
+        atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+// Function to add to a counter of the calling thread
+static inline void metrics_add(MetricCounter counter, unsigned long long n) {
+    MetricsSlot *slot = metricsSlot != NULL ? metricsSlot : metrics_register();
+    metrics_bump(&slot->counter[counter], n, slot->shared);
+}
+
+void metrics_phase(MetricPhase phase, double seconds);
+int metrics_snapshot(unsigned long long counters[METRIC_COUNT], double phaseSeconds[PHASE_COUNT]);
+void metrics_write(FILE *out, MetricsFormat format);
+int metrics_export(const char *path, MetricsFormat format);
+int metrics_start(const char *path, MetricsFormat format, double interval);
+void metrics_stop();
+
+// Timeline spans written as Chrome trace events (trace.c), compiled in only with -DSUDOKU_TRACE.
+// TRACE_BEGIN(span) starts a span in a local variable, TRACE_END(span, "name") records it and
+// TRACE_RESTART(span) starts it again. Names must be string literals.
+#ifdef SUDOKU_TRACE
+double trace_now();
+void trace_span(const char *name, double start);
+void trace_thread_name(const char *name);
+int trace_start(const char *path);
+void trace_stop();
+
+#define TRACE_BEGIN(span) double span##TraceStart = trace_now()
+#define TRACE_END(span, name) trace_span(name, span##TraceStart)
+#define TRACE_RESTART(span) (span##TraceStart = trace_now())
+#define TRACE_THREAD(name) trace_thread_name(name)
+#else
+#define TRACE_BEGIN(span) ((void) 0)
+#define TRACE_END(span, name) ((void) 0)
+#define TRACE_RESTART(span) ((void) 0)
+#define TRACE_THREAD(name) ((void) 0)
+#endif
+
+// Hardware counters around the solver hot paths (perf.c), opt-in with --perf. Every thread counts
+// its own cycles, instructions, cache misses and branch misses with perf_event_open (Linux only);
+// PERF_BEGIN(sample) starts a measurement and PERF_END(sample, region, report) adds it to the region.
+typedef enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_BRANCH_MISSES, PERF_EVENT_COUNT } PerfEvent;
+
+typedef enum {
+    PERF_FILL,            // fillBoardBacktrack (board generation)
+    PERF_BACKTRACK,       // solveBacktrack
+    PERF_SA,              // runSA
+    PERF_GA,              // runGA
+    PERF_GA_GENERATION,   // One GA generation (totals only)
+    PERF_MC,              // runMC
+    PERF_REGION_COUNT
+} PerfRegion;
+
+typedef struct {
+    double start;
+    unsigned long long value[PERF_EVENT_COUNT];
+    unsigned valid;  // Bit e set if event e was read
+} PerfSample;
+
+extern int perfEnabled;
+void perf_begin(PerfSample *sample);
+void perf_end(PerfSample *sample, PerfRegion region, int report);
+int perf_start(const char *path);
+void perf_stop();
+
+#define PERF_BEGIN(sample) PerfSample sample; if (perfEnabled) perf_begin(&sample)
+#define PERF_END(sample, region, report) do { if (perfEnabled) perf_end(&sample, region, report); } while (0)
+
+// Periodic snapshots of the SA and GA search state, to resume a run after an interruption (checkpoint.c)
+typedef enum {
+    CHECKPOINT_SA,
+    CHECKPOINT_GA
+} CheckpointKind;
+
+typedef struct Checkpoint Checkpoint;
+
+extern const char *checkpointPath;   // Path prefix set by --checkpoint (NULL = no checkpoints)
+extern double checkpointInterval;    // Seconds between snapshots
+Checkpoint *checkpoint_open(CheckpointKind kind, const cell_t *puzzle, const unsigned char *fixed, size_t payload,
+                            int *resumed);
+void checkpoint_read(Checkpoint *cp, void *data, size_t len);
+int checkpoint_due(const Checkpoint *cp);
+void checkpoint_begin(Checkpoint *cp);
+void checkpoint_put(Checkpoint *cp, const void *data, size_t len);
+void checkpoint_commit(Checkpoint *cp);
+void checkpoint_close(Checkpoint *cp, int finished);
+
+// Solvers. The limits may be NULL; a stopped solver leaves its best board.
+SolveResult runSA(int **board, const SolveLimits *limits);                     // sa_sudoku.c
+SolveResult runMC(int **board, const SolveLimits *limits);                     // mc_sudoku.c
+SolveResult runGA(int **board, int **fixed, const SolveLimits *limits);        // ga_sudoku.c
+extern int gaLocalSteps;  // Min-conflicts moves applied to every GA child (0 = plain GA)
+SolveResult runPortfolio(int **board, int **fixed, const SolveLimits *limits);  // portfolio_sudoku.c
+int runBatch(const char *inputPath, const char *outputPath, int workers);      // batch_sudoku.c
+int runServer(const char *socketPath, int workers);                            // server_sudoku.c
+int runPipeline(const char *inputPath, const char *outputPath, int workers);   // pipeline_sudoku.c
+int runVerify(const char *puzzlePath, const char *solutionPath);              // validate_sudoku.c
+int runPack(const char *inputPath, const char *outputPath);                    // codec_sudoku.c
+int runUnpack(const char *inputPath, const char *outputPath);                  // codec_sudoku.c
+
+// Exhaustive search over all solutions of a partial board, split over several threads (count_sudoku.c)
+typedef void (*SolutionSink)(const int *cells, void *context);  // Gets size * size cells row by row, one call at a time
+
+typedef struct {
+    long long solutions;   // Solutions found (never more than the limit)
+    int exhaustive;        // 1 if every solution was visited, so the count is exact
+    SolveStatus status;    // SOLVE_SOLVED or SOLVE_UNSOLVED, or the solver limit that stopped the search
+    long long nodes;       // Placements tried by all threads
+    int tasks;             // Subproblems the search tree was split into
+    int threads;
+    double elapsed;        // Seconds
+} CountResult;
+
+// Digit masks for the exhaustive searches: used[u] holds the digits placed in unit u
+int digit_masks_load(const Geometry *g, const cell_t *grid, DigitSet *used, int *empty, int *emptyCount);
+DigitSet digit_masks_pick(const Geometry *g, const cell_t *grid, const DigitSet *used, int *empty, int emptyCount, int depth);
+
+// Function to get the digits a cell cannot take: those of its units and, on variant boards,
+// of its extra units and pair cells
+static inline DigitSet digit_masks_taken(const Geometry *g, const cell_t *grid, const DigitSet *used, int cell) {
+    const int *u = &g->cellUnits[cell * UNITS_PER_CELL];
+    DigitSet taken = used[u[0]] | used[u[1]] | used[u[2]];
+    if (g->variant) {
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++)
+            taken |= used[g->extraUnits[k]];
+        for (int k = g->pairStart[cell]; k < g->pairStart[cell + 1]; k++)
+            if (grid[g->pairs[k]]) taken |= DIGIT_BIT(grid[g->pairs[k]]);
+    }
+    return taken;
+}
+
+// Function to place (or take back) a digit bit in the units of a cell
+static inline void digit_masks_flip(const Geometry *g, DigitSet *used, int cell, DigitSet bit) {
+    const int *u = &g->cellUnits[cell * UNITS_PER_CELL];
+    used[u[0]] ^= bit;
+    used[u[1]] ^= bit;
+    used[u[2]] ^= bit;
+    if (g->variant)
+        for (int k = g->extraStart[cell]; k < g->extraStart[cell + 1]; k++)
+            used[g->extraUnits[k]] ^= bit;
+}
+CountResult count_solutions(int **board, int threads, long long limit, const SolveLimits *limits);
+CountResult enumerate_solutions(int **board, int threads, long long limit, const SolveLimits *limits,
+                                SolutionSink sink, void *context);
+
+// Lockstep solving of classic 9x9 puzzles (batch_sudoku.c)
+#define BATCH_SIZE 9
+#define BATCH_CELLS (BATCH_SIZE * BATCH_SIZE)
+#define BATCH_LANES 16  // Puzzles solved at once, one per SIMD lane
+
+void batch_prepare();
+int batch_parse(const char *line, int cells[BATCH_CELLS]);
+void batch_solve(int puzzles[][BATCH_CELLS], int count, int solutions[][BATCH_CELLS], int results[]);
+
+// CPUs the program may run on, grouped by NUMA node, for pinning worker threads (topology.c)
+typedef struct {
+    int count;   // Entries of cpu and node
+    int nodes;   // NUMA nodes with at least one of the CPUs
+    int *cpu;    // CPU numbers, node by node (-1 if unknown)
+    int *node;   // Node of every CPU
+} CpuTopology;
+
+void topology_load(CpuTopology *t);
+void topology_free(CpuTopology *t);
+int topology_slot(const CpuTopology *t, int w, int workers);
+int topology_pin(int cpu);
+
+// Bulk checking of solved 9x9 grids packed as BATCH_CELLS bytes each, BATCH_LANES at a time (validate_sudoku.c)
+int validate_grids(const unsigned char *grids, const unsigned char *clues, int count, unsigned char *valid);
+int validate_grid(const unsigned char *grid, const unsigned char *clues);
+
+// Compact codes of packed 9x9 grids and puzzles for archives (codec_sudoku.c)
+#define CODEC_GRID_BYTES 14         // Solved grid: candidate rank of every digit, 105 bits
+#define CODEC_PUZZLE_MAX_BYTES 44   // Puzzle: clue bitmap and clue values packed base 9
+
+int codec_encode_grid(const unsigned char grid[BATCH_CELLS], unsigned char out[CODEC_GRID_BYTES]);
+int codec_decode_grid(const unsigned char in[CODEC_GRID_BYTES], unsigned char grid[BATCH_CELLS]);
+int codec_encode_puzzle(const unsigned char cells[BATCH_CELLS], unsigned char *out);
+int codec_decode_puzzle(const unsigned char *in, int len, unsigned char cells[BATCH_CELLS]);
+
+// Board output formatted into one buffer and written with a single write() per frame (render.c).
+// Values are shown as one character each: 1-9, then A-Z and a-z.
+typedef struct {
+    int fd;             // Where the frames go
+    int changedOnly;    // Later frames only redraw the changed cells with ANSI cursor moves
+    int n, boxRows;     // Shape of the board on screen (0 = nothing drawn yet)
+    int *shown;         // Values on screen, row by row
+    char *buffer;       // Frame being built
+    size_t capacity;
+} BoardRenderer;
+
+extern int redrawChanged;  // displayBoard redraws only the changed cells (--redraw changed)
+
+char render_glyph(int value);
+void render_init(BoardRenderer *r, int fd, int changedOnly);
+void render_free(BoardRenderer *r);
+void render_invalidate(BoardRenderer *r);
+size_t render_frame(BoardRenderer *r, int **board);
+void render_board(BoardRenderer *r, int **board);
+void displayBoard(int **board);
+void displayReset();
+
+// One player move, kept in the undo journal
+typedef struct {
+    int row, col;
+    int oldValue, newValue;
+} Move;
+
+// Incrementally maintained game state (game_state.c).
+// Digit counts per unit make move validation, undo and the completion check O(1).
+typedef struct {
+    int **board;              // Board being played (not owned)
+    int **fixed;              // Fixed cells of the board (not owned)
+    const Geometry *geom;     // Geometry captured at initialization
+    unsigned char *count;     // count[u * (size + 1) + v] = how many times v appears in unit u
+    DigitSet *mask;           // Bit v-1 of mask[u] set when v appears in unit u
+    int filled;               // Number of non-empty cells
+    int conflicts;            // Number of repeated digits over all rows, columns and boxes
+    Move *journal;            // Applied moves followed by moves that can be redone
+    int journalPos;           // Number of applied moves
+    int journalLen;           // Number of recorded moves
+    int journalCap;
+} GameState;
+
+void game_init(GameState *game, int **board, int **fixed);
+void game_free(GameState *game);
+int game_can_place(const GameState *game, int row, int col, int val);
+void game_set(GameState *game, int row, int col, int val);
+int game_undo(GameState *game);
+int game_redo(GameState *game);
+int game_finished(const GameState *game);
+
+#endif
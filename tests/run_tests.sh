@@ -0,0 +1,114 @@
+#!/bin/sh
+# Checks of the command line modes against small fixed inputs.
+# Run from the repository root: sh tests/run_tests.sh (exit status 1 if a check fails).
+# CFLAGS replaces -O2, e.g. CFLAGS="-g -fsanitize=address,undefined" sh tests/run_tests.sh
+
+tests=$(dirname "$0")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+bin="$work/SudokuSolver"
+gcc -std=gnu11 ${CFLAGS:--O2} -Wall -Wextra -pthread *.c -lm -o "$bin" || exit 1
+
+failed=0
+
+# Function to check the board printed by solve against the saved game: every row, column and box holds
+# each symbol once, and the given cells keep their values (square boxes only)
+valid_solution() {
+    awk 'NR == FNR {
+             if (FNR == 1) { n = $1; box = $2 }
+             else if (FNR <= n + 1) for (c = 1; c <= n; c++) given[FNR - 2, c - 1] = $c
+             next
+         }
+         {
+             gsub(/\|/, " ")
+             if (NF != n) next
+             for (c = 1; c <= NF; c++) if (length($c) != 1) next
+             for (c = 0; c < n; c++) {
+                 v = index("123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ", $(c + 1))
+                 if (v == 0 || v > n || (given[r, c] != 0 && given[r, c] != v)) bad = 1
+                 if (seen["r", r, v]++ || seen["c", c, v]++ || seen["b", int(r / box), int(c / box), v]++) bad = 1
+             }
+             r++
+         }
+         END { exit bad || r != n }' "$1" "$2"
+}
+
+# Function to run one check (a shell function) and report it
+check() {
+    if "$1" > "$work/$1.log" 2>&1; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1"
+        sed 's/^/     /' "$work/$1.log"
+        failed=1
+    fi
+}
+
+# pack then unpack gives back the same puzzle and solution lines
+codec_round_trip() {
+    "$bin" batch "$tests/puzzles.txt" "$work/solutions.txt" 1 || return 1
+    cat "$tests/puzzles.txt" "$work/solutions.txt" > "$work/lines.txt"
+    "$bin" pack "$work/lines.txt" "$work/lines.pack" &&
+        "$bin" unpack "$work/lines.pack" "$work/unpacked.txt" &&
+        cmp "$work/lines.txt" "$work/unpacked.txt"
+}
+
+# Every batch solution passes verify, and a solution with two digits swapped fails it
+verify_solutions() {
+    "$bin" batch "$tests/puzzles.txt" "$work/solutions.txt" 1 &&
+        "$bin" verify "$tests/puzzles.txt" "$work/solutions.txt" || return 1
+    sed '1s/^\(.\)\(.\)/\2\1/' "$work/solutions.txt" > "$work/swapped.txt"
+    ! "$bin" verify "$tests/puzzles.txt" "$work/swapped.txt"
+}
+
+# An empty 4x4 board has 288 solutions; the count is exact unless the limit cut the search short
+count_empty_4x4() {
+    for threads in 1 4; do
+        "$bin" count "$tests/games/empty4.txt" 0 $threads | grep -q '^288 solutions (' &&
+            "$bin" count "$tests/games/empty4.txt" 288 $threads | grep -q '^288 solutions (' &&
+            "$bin" count "$tests/games/empty4.txt" 287 $threads | grep -q '^287 solutions or more' || return 1
+    done
+}
+
+# solve parallel keeps a full board and gives up on conflicting givens, without starting a search
+parallel_trivial_boards() {
+    "$bin" solve parallel "$tests/games/full9.txt" --threads 4 > "$work/full.out" &&
+        grep -q 'solved (energy 0, 0 iterations' "$work/full.out" || return 1
+    ! "$bin" solve parallel "$tests/games/conflict9.txt" --threads 4 > "$work/conflict.out" &&
+        grep -q 'not solved (energy [0-9]*, 0 iterations' "$work/conflict.out"
+}
+
+# The SAT engine solves a 16x16 puzzle into a valid grid that keeps the givens
+sat_16x16() {
+    "$bin" solve sat "$tests/games/puzzle16.txt" 60 > "$work/sat.out" &&
+        valid_solution "$tests/games/puzzle16.txt" "$work/sat.out"
+}
+
+# With a fixed seed, annealing stopped by its budget and resumed from the checkpoint ends like a run
+# that was never interrupted
+sa_checkpoint_resume() {
+    game="$tests/games/puzzle16.txt"
+    "$bin" --seed 7 solve sa "$game" 0 300000 | sed 's/, [0-9.]* s)/)/' > "$work/straight.out"
+    "$bin" --seed 7 --checkpoint "$work/run" solve sa "$game" 0 100000 > /dev/null
+    test -f "$work/run.sa" || return 1
+    "$bin" --seed 7 --checkpoint "$work/run" solve sa "$game" 0 300000 > "$work/resumed.out"
+    grep -q '^Resuming from checkpoint' "$work/resumed.out" &&
+        grep -v '^Resuming' "$work/resumed.out" | sed 's/, [0-9.]* s)/)/' | cmp - "$work/straight.out"
+}
+
+# The portfolio hands its iteration budget to every engine, so a hopeless board stops on the budget
+# long before the deadline
+portfolio_budget() {
+    ! "$bin" --seed 1 solve portfolio "$tests/games/conflict9.txt" 30 1000 > "$work/portfolio.out" &&
+        grep -q '^Portfolio: iteration budget used up' "$work/portfolio.out"
+}
+
+check codec_round_trip
+check verify_solutions
+check count_empty_4x4
+check parallel_trivial_boards
+check portfolio_budget
+check sat_16x16
+check sa_checkpoint_resume
+
+exit $failed
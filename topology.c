@@ -0,0 +1,122 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // sched_getaffinity, pthread_setaffinity_np
+#include <dirent.h>
+#include <sched.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "sudoku.h"
+
+#ifdef __linux__
+
+// Function to mark the CPUs of a list like "0-3,8-11" (the cpulist file of a node) as belonging to the node
+static void readCpuList(const char *path, int node, int *nodeOf) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return;
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1) {
+        last = first;
+        int c = fgetc(file);
+        if (c == '-' && fscanf(file, "%d", &last) == 1)
+            c = fgetc(file);
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+            if (cpu >= 0) nodeOf[cpu] = node;
+        if (c != ',')
+            break;
+    }
+    fclose(file);
+}
+
+// Function to list the CPUs this process may run on (taskset, cgroups) with the NUMA node of each,
+// ordered node by node. Machines without /sys/devices/system/node count as one node.
+void topology_load(CpuTopology *t) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        for (int cpu = 0; cpu < sysconf(_SC_NPROCESSORS_ONLN) && cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &allowed);
+    }
+
+    int *nodeOf = malloc(CPU_SETSIZE * sizeof(int));
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) nodeOf[cpu] = 0;
+    int maxNode = 0;
+    DIR *dir = opendir("/sys/devices/system/node");
+    if (dir != NULL) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            int node;
+            char path[300];
+            if (sscanf(entry->d_name, "node%d", &node) != 1 || node < 0)
+                continue;
+            snprintf(path, sizeof(path), "/sys/devices/system/node/%s/cpulist", entry->d_name);
+            readCpuList(path, node, nodeOf);
+            if (node > maxNode) maxNode = node;
+        }
+        closedir(dir);
+    }
+
+    t->count = 0;
+    t->nodes = 0;
+    t->cpu = malloc(CPU_COUNT(&allowed) * sizeof(int) + sizeof(int));
+    t->node = malloc(CPU_COUNT(&allowed) * sizeof(int) + sizeof(int));
+    for (int node = 0; node <= maxNode; node++) {
+        int before = t->count;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (nodeOf[cpu] != node || !CPU_ISSET(cpu, &allowed))
+                continue;
+            t->cpu[t->count] = cpu;
+            t->node[t->count++] = node;
+        }
+        if (t->count > before) t->nodes++;
+    }
+    free(nodeOf);
+    if (t->count == 0) {  // No usable information: one CPU we do not pin to
+        t->cpu[0] = -1;
+        t->node[0] = 0;
+        t->count = t->nodes = 1;
+    }
+}
+
+// Function to keep the calling thread on one CPU, so it stays next to the memory it touched first.
+// Returns 0 if the CPU is not known or the system refuses.
+int topology_pin(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+        return 0;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#else
+
+// Without the Linux affinity calls every online CPU counts as one node and threads are not pinned
+void topology_load(CpuTopology *t) {
+    int count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (count <= 0) count = 1;
+    t->count = count;
+    t->nodes = 1;
+    t->cpu = malloc(count * sizeof(int));
+    t->node = calloc(count, sizeof(int));
+    for (int i = 0; i < count; i++) t->cpu[i] = -1;
+}
+
+int topology_pin(int cpu) {
+    (void) cpu;
+    return 0;
+}
+
+#endif
+
+void topology_free(CpuTopology *t) {
+    free(t->cpu);
+    free(t->node);
+}
+
+// Function to choose the CPU of worker w out of workers: with fewer workers than CPUs they are spread
+// evenly over the list, so every node gets its share; with more they go round it
+int topology_slot(const CpuTopology *t, int w, int workers) {
+    return workers <= t->count ? (int) ((long) w * t->count / workers) : w % t->count;
+}
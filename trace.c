@@ -0,0 +1,115 @@
+#include "sudoku.h"
+
+// Only built with -DSUDOKU_TRACE; otherwise the TRACE_ macros expand to nothing
+#ifdef SUDOKU_TRACE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// One finished span
+typedef struct {
+    const char *name;   // String literal given to TRACE_END
+    double start, end;  // solver_clock() times
+} TraceEvent;
+
+// Spans of one thread. Only the owning thread appends, so recording needs no lock.
+typedef struct TraceBuffer {
+    int tid;
+    const char *threadName;
+    TraceEvent *events;
+    int count, cap;
+    struct TraceBuffer *next;
+} TraceBuffer;
+
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *buffers = NULL;
+static int threadCount = 0;
+static _Thread_local TraceBuffer *ownBuffer = NULL;
+static atomic_int tracing = 0;
+static char tracePath[4096];
+static double traceOrigin;
+
+// Function to get the buffer of the calling thread, registering it on first use
+static TraceBuffer *traceBuffer() {
+    if (ownBuffer != NULL)
+        return ownBuffer;
+    TraceBuffer *buffer = calloc(1, sizeof(TraceBuffer));
+    pthread_mutex_lock(&registryLock);
+    buffer->tid = ++threadCount;
+    buffer->next = buffers;
+    buffers = buffer;
+    pthread_mutex_unlock(&registryLock);
+    ownBuffer = buffer;
+    return buffer;
+}
+
+// Function to read the clock for the start of a span
+double trace_now() {
+    return atomic_load_explicit(&tracing, memory_order_relaxed) ? solver_clock() : 0;
+}
+
+// Function to record a span of the calling thread that started at the given time and ends now
+void trace_span(const char *name, double start) {
+    if (!atomic_load_explicit(&tracing, memory_order_relaxed))
+        return;
+    TraceBuffer *buffer = traceBuffer();
+    if (buffer->count == buffer->cap) {
+        buffer->cap = buffer->cap ? 2 * buffer->cap : 1024;
+        buffer->events = realloc(buffer->events, buffer->cap * sizeof(TraceEvent));
+    }
+    TraceEvent *event = &buffer->events[buffer->count++];
+    event->name = name;
+    event->start = start;
+    event->end = solver_clock();
+}
+
+// Function to name the track of the calling thread in the trace viewer
+void trace_thread_name(const char *name) {
+    if (atomic_load(&tracing))
+        traceBuffer()->threadName = name;
+}
+
+// Function to start recording spans; they are written to the file by trace_stop
+int trace_start(const char *path) {
+    snprintf(tracePath, sizeof(tracePath), "%s", path);
+    traceOrigin = solver_clock();
+    atomic_store(&tracing, 1);
+    trace_thread_name("main");
+    return 1;
+}
+
+// Function to write all recorded spans as Chrome trace event JSON (chrome://tracing, Perfetto).
+// Call it once the solver threads have finished.
+void trace_stop() {
+    if (!atomic_exchange(&tracing, 0))
+        return;
+    FILE *file = fopen(tracePath, "w");
+    if (file == NULL) {
+        printf("Error opening %s for writing.\n", tracePath);
+        return;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    int first = 1;
+    pthread_mutex_lock(&registryLock);
+    for (TraceBuffer *buffer = buffers; buffer != NULL; buffer = buffer->next) {
+        if (buffer->threadName != NULL) {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                    first ? "" : ",\n", buffer->tid, buffer->threadName);
+            first = 0;
+        }
+        for (int e = 0; e < buffer->count; e++) {
+            const TraceEvent *event = &buffer->events[e];
+            fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                    first ? "" : ",\n", event->name, buffer->tid, (event->start - traceOrigin) * 1e6,
+                    (event->end - event->start) * 1e6);
+            first = 0;
+        }
+    }
+    pthread_mutex_unlock(&registryLock);
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
+
+#endif
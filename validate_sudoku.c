@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sudoku.h"
+
+#define VALIDATE_ALL_DIGITS 0x1FF   // Digits 1..9 of a complete unit
+#define VALIDATE_CHUNK 4096         // Grids read from the files at a time by runVerify
+
+// Digit bits of a group of cells, one grid per lane; like the batch solver's candidate masks,
+// GCC turns the operations on it into AVX2 with -mavx2 and SSE2 pairs otherwise
+typedef unsigned short GridLanes __attribute__((vector_size(BATCH_LANES * sizeof(unsigned short))));
+
+// The same bits written lane by lane
+typedef union {
+    GridLanes v;
+    unsigned short lane[BATCH_LANES];
+} CellLanes;
+
+// Bit of every byte value: digits 1..9 get their bit, anything else 0 so that its unit can never be complete
+static const unsigned short digitBits[256] = {
+    [1] = 1 << 0, [2] = 1 << 1, [3] = 1 << 2, [4] = 1 << 3, [5] = 1 << 4,
+    [6] = 1 << 5, [7] = 1 << 6, [8] = 1 << 7, [9] = 1 << 8
+};
+
+// Function to check up to BATCH_LANES packed grids at once; bit l of the result is set if grid l is valid.
+// Spare lanes repeat the first grid.
+static unsigned int validateLanes(const unsigned char *grids, const unsigned char *clues, int count) {
+    CellLanes bits[BATCH_CELLS], bad;
+
+    // Grid by grid, so every grid is read in one sweep: the digit bits go to the lanes and a given
+    // cell must keep its digit
+    for (int l = 0; l < BATCH_LANES; l++) {
+        const unsigned char *grid = grids + (l < count ? l : 0) * BATCH_CELLS;
+        const unsigned char *clue = clues != NULL ? clues + (l < count ? l : 0) * BATCH_CELLS : NULL;
+        unsigned char wrong = 0;
+        for (int i = 0; i < BATCH_CELLS; i++) {
+            bits[i].lane[l] = digitBits[grid[i]];
+            if (clue != NULL)
+                wrong |= clue[i] != 0 && clue[i] != grid[i];
+        }
+        bad.lane[l] = wrong;
+    }
+
+    // Every row, column and box must hold all nine digits; with nine cells each of them appears once
+    for (int u = 0; u < BATCH_SIZE; u++) {
+        GridLanes row = {0}, col = {0}, box = {0};
+        int boxStart = (u / 3) * 3 * BATCH_SIZE + (u % 3) * 3;
+        for (int k = 0; k < BATCH_SIZE; k++) {
+            row |= bits[u * BATCH_SIZE + k].v;
+            col |= bits[k * BATCH_SIZE + u].v;
+            box |= bits[boxStart + (k / 3) * BATCH_SIZE + k % 3].v;
+        }
+        bad.v |= (row ^ VALIDATE_ALL_DIGITS) | (col ^ VALIDATE_ALL_DIGITS) | (box ^ VALIDATE_ALL_DIGITS);
+    }
+
+    unsigned int valid = 0;
+    for (int l = 0; l < count; l++)
+        if (bad.lane[l] == 0) valid |= 1u << l;
+    return valid;
+}
+
+// Function to check packed 9x9 grids (BATCH_CELLS bytes each, digits 1..9) straight from a buffer.
+// clues holds the puzzles in the same layout, 0 for cells that were not given (the fixed mask of a
+// saved game is clues != 0); with clues NULL only the rows, columns and boxes are checked.
+// valid[g] (if not NULL) is set to 1 or 0 for every grid. Returns the number of valid grids.
+// Safe to call from several threads.
+int validate_grids(const unsigned char *grids, const unsigned char *clues, int count, unsigned char *valid) {
+    int total = 0;
+    for (int first = 0; first < count; first += BATCH_LANES) {
+        int lanes = count - first < BATCH_LANES ? count - first : BATCH_LANES;
+        unsigned int mask = validateLanes(grids + (size_t) first * BATCH_CELLS,
+                                          clues != NULL ? clues + (size_t) first * BATCH_CELLS : NULL, lanes);
+        total += __builtin_popcount(mask);
+        if (valid != NULL)
+            for (int l = 0; l < lanes; l++) valid[first + l] = (mask >> l) & 1;
+    }
+    return total;
+}
+
+// Function to check one packed 9x9 grid against its clues (which may be NULL); returns 1 if it is valid
+int validate_grid(const unsigned char *grid, const unsigned char *clues) {
+    return validate_grids(grid, clues, 1, NULL);
+}
+
+// Function to read the next puzzle line, skipping blank lines and comments; returns 0 at the end of the file
+static int readLine(FILE *file, char *line, int size) {
+    while (fgets(line, size, file) != NULL)
+        if (line[0] != '\n' && line[0] != '\r' && line[0] != '#')
+            return 1;
+    return 0;
+}
+
+// Function to check the output of the batch command against its input: every solution line must
+// solve the puzzle on the same line. Returns 0 if no solution is wrong.
+int runVerify(const char *puzzlePath, const char *solutionPath) {
+    FILE *puzzles = fopen(puzzlePath, "r");
+    if (puzzles == NULL) {
+        printf("Error opening %s for reading.\n", puzzlePath);
+        return 1;
+    }
+    FILE *solutions = fopen(solutionPath, "r");
+    if (solutions == NULL) {
+        printf("Error opening %s for reading.\n", solutionPath);
+        fclose(puzzles);
+        return 1;
+    }
+
+    unsigned char *grids = malloc(VALIDATE_CHUNK * BATCH_CELLS), *clues = malloc(VALIDATE_CHUNK * BATCH_CELLS);
+    int cells[BATCH_CELLS];
+    char line[256];
+    long total = 0, valid = 0, unsolved = 0;
+    double checking = 0, start = solver_clock();
+    int more = 1;
+
+    while (more) {
+        int count = 0;
+        while (count < VALIDATE_CHUNK && (more = readLine(puzzles, line, sizeof(line)))) {
+            int given = batch_parse(line, cells);
+            if (!readLine(solutions, line, sizeof(line))) {
+                more = 0;  // Fewer solutions than puzzles: the rest count as not solved
+                total++;
+                unsolved++;
+                break;
+            }
+            total++;
+            if (!given || strncmp(line, "unsolvable", 10) == 0 || strncmp(line, "invalid", 7) == 0) {
+                unsolved++;
+                continue;
+            }
+            for (int i = 0; i < BATCH_CELLS; i++)
+                clues[count * BATCH_CELLS + i] = (unsigned char) cells[i];
+            if (!batch_parse(line, cells))
+                memset(cells, 0, sizeof(cells));  // Not a grid at all: fails the check
+            for (int i = 0; i < BATCH_CELLS; i++)
+                grids[count * BATCH_CELLS + i] = (unsigned char) cells[i];
+            count++;
+        }
+        double t = solver_clock();
+        valid += validate_grids(grids, clues, count, NULL);
+        checking += solver_clock() - t;
+    }
+    while (readLine(puzzles, line, sizeof(line))) {
+        total++;
+        unsolved++;
+    }
+    fclose(puzzles);
+    fclose(solutions);
+    free(grids);
+    free(clues);
+
+    long checked = total - unsolved;
+    printf("Verify finished: %ld puzzles, %ld valid solutions, %ld wrong, %ld not solved (%.3f s, %.0f grids/s checked)\n",
+           total, valid, checked - valid, unsolved, solver_clock() - start, checking > 0 ? checked / checking : 0.0);
+    return checked != valid;
+}